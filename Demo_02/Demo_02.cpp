@@ -1,235 +1,5113 @@
-﻿#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <vector>
-#include <map>
-#include <stack>
-#include <set>
-
-using namespace std;
-
-struct Token {
-    int line;
-    string type;
-    string value;
-};
-
-struct GrammarRule {
-    string lhs;
-    vector<string> rhs;
-};
-
-class LL1Parser {
-private:
-    vector<GrammarRule> grammar;
-    set<string> terminals, nonTerminals;
-    map<string, set<string>> firstSet, followSet;
-    map<pair<string, string>, GrammarRule> parseTable;
-    string startSymbol;
-
-public:
-    void loadGrammar(const string& filename);
-    void computeFirst();
-    void computeFollow();
-    void buildParseTable();
-    bool parseTokens(const vector<Token>& tokens, const string& outputErrFile);
-
-private:
-    void split(const string& line, vector<string>& out);
-    set<string> computeFirstOf(const vector<string>& symbols);
-    bool isTerminal(const string& symbol);
-    set<string> computeFollowOf(const string& nonTerminal);
-};
-
-// Load grammar rules from file
-void LL1Parser::loadGrammar(const string& filename) {
-    ifstream infile(filename);
-    string line;
-    while (getline(infile, line)) {
-        if (line.empty()) continue;
-        vector<string> parts;
-        split(line, parts);
-        if (parts.size() < 3 || parts[1] != "->") continue;
-        GrammarRule rule;
-        rule.lhs = parts[0];
-        for (size_t i = 2; i < parts.size(); ++i) rule.rhs.push_back(parts[i]);
-        grammar.push_back(rule);
-        nonTerminals.insert(rule.lhs);
-        for (const string& sym : rule.rhs) {
-            if (!isupper(sym[0])) terminals.insert(sym);
-            else nonTerminals.insert(sym);
-        }
-        if (startSymbol.empty()) startSymbol = rule.lhs;
-    }
-}
-
-// Split a grammar rule line into tokens
-void LL1Parser::split(const string& line, vector<string>& out) {
-    stringstream ss(line);
-    string token;
-    while (ss >> token) out.push_back(token);
-}
-
-// Check if a symbol is a terminal
-bool LL1Parser::isTerminal(const string& symbol) {
-    return terminals.find(symbol) != terminals.end();
-}
-
-// Compute the FIRST set for a given symbol sequence
-set<string> LL1Parser::computeFirstOf(const vector<string>& symbols) {
-    set<string> first;
-    for (const string& symbol : symbols) {
-        if (isTerminal(symbol)) {
-            first.insert(symbol);
-            break;
-        }
-        else {
-            set<string> firstOfNonTerminal = firstSet[symbol];
-            first.insert(firstOfNonTerminal.begin(), firstOfNonTerminal.end());
-            if (firstOfNonTerminal.find("epsilon") == firstOfNonTerminal.end()) break;
-        }
-    }
-    return first;
-}
-
-// Compute the FIRST sets for all non-terminals
-void LL1Parser::computeFirst() {
-    bool changed = true;
-    while (changed) {
-        changed = false;
-        for (const GrammarRule& rule : grammar) {
-            set<string> firstOfLHS = firstSet[rule.lhs];
-            set<string> firstOfRHS = computeFirstOf(rule.rhs);
-            size_t oldSize = firstOfLHS.size();
-            firstOfLHS.insert(firstOfRHS.begin(), firstOfRHS.end());
-            firstSet[rule.lhs] = firstOfLHS;
-            if (firstOfLHS.size() > oldSize) changed = true;
-        }
-    }
-}
-
-// Compute the FOLLOW set for a given non-terminal
-set<string> LL1Parser::computeFollowOf(const string& nonTerminal) {
-    set<string> follow;
-    if (nonTerminal == startSymbol) follow.insert("$");
-
-    for (const GrammarRule& rule : grammar) {
-        for (size_t i = 0; i < rule.rhs.size(); ++i) {
-            if (rule.rhs[i] == nonTerminal) {
-                if (i + 1 < rule.rhs.size()) {
-                    set<string> firstOfNext = computeFirstOf(vector<string>(rule.rhs.begin() + i + 1, rule.rhs.end()));
-                    follow.insert(firstOfNext.begin(), firstOfNext.end());
-                    if (firstOfNext.find("epsilon") != firstOfNext.end()) {
-                        set<string> followOfLHS = followSet[rule.lhs];
-                        follow.insert(followOfLHS.begin(), followOfLHS.end());
-                    }
-                }
-                else {
-                    set<string> followOfLHS = followSet[rule.lhs];
-                    follow.insert(followOfLHS.begin(), followOfLHS.end());
-                }
-            }
-        }
-    }
-    return follow;
-}
-
-// Compute the FOLLOW sets for all non-terminals
-void LL1Parser::computeFollow() {
-    bool changed = true;
-    while (changed) {
-        changed = false;
-        for (const GrammarRule& rule : grammar) {
-            for (size_t i = 0; i < rule.rhs.size(); ++i) {
-                if (nonTerminals.find(rule.rhs[i]) != nonTerminals.end()) {
-                    set<string> followOfRHS = computeFollowOf(rule.rhs[i]);
-                    size_t oldSize = followSet[rule.rhs[i]].size();
-                    followSet[rule.rhs[i]].insert(followOfRHS.begin(), followOfRHS.end());
-                    if (followSet[rule.rhs[i]].size() > oldSize) changed = true;
-                }
-            }
-        }
-    }
-}
-
-// Build the parse table using FIRST and FOLLOW sets
-void LL1Parser::buildParseTable() {
-    for (const GrammarRule& rule : grammar) {
-        set<string> firstOfRHS = computeFirstOf(rule.rhs);
-        for (const string& terminal : firstOfRHS) {
-            if (terminal != "epsilon") {
-                parseTable[{rule.lhs, terminal}] = rule;
-            }
-        }
-        if (firstOfRHS.find("epsilon") != firstOfRHS.end()) {
-            set<string> followOfLHS = followSet[rule.lhs];
-            for (const string& terminal : followOfLHS) {
-                parseTable[{rule.lhs, terminal}] = rule;
-            }
-        }
-    }
-}
-
-// Parse the token list using the LL(1) table
-bool LL1Parser::parseTokens(const vector<Token>& tokens, const string& outputErrFile) {
-    stack<string> parseStack;
-    parseStack.push("$");
-    parseStack.push(startSymbol);
-    size_t index = 0;
-    vector<Token> input = tokens;
-    input.push_back({ -1, "$", "$" });
-    ofstream errFile(outputErrFile);
-
-    while (!parseStack.empty()) {
-        string top = parseStack.top();
-        string currentToken = input[index].type;
-        if (top == "$" && currentToken == "$") {
-            cout << "YES" << endl;
-            return true;
-        }
-        else if (top == currentToken) {
-            parseStack.pop();
-            ++index;
-        }
-        else if (isTerminal(top)) {
-            errFile << "Syntax error at line " << input[index].line << ": expected '" << top << "' but found '" << input[index].value << "'\n";
-            cout << "NO" << endl;
-            return false;
-        }
-        else {
-            auto it = parseTable.find({ top, currentToken });
-            if (it == parseTable.end()) {
-                errFile << "Syntax error at line " << ((input[index].line < 0) ? input[index - 1].line : input[index].line) << ": unexpected token '" << ((input[index].value == "$") ? input[index - 1].value : input[index].value) << "'\n";
-                cout << "NO" << endl;
-                return false;
-            }
-            parseStack.pop();
-            const GrammarRule& rule = it->second;
-            for (auto it = rule.rhs.rbegin(); it != rule.rhs.rend(); ++it) {
-                if (*it != "epsilon") parseStack.push(*it);
-            }
-        }
-    }
-    return false;
-}
-
-int main(int argc, char* argv[]) {
-    LL1Parser parser;
-    parser.loadGrammar(argv[1]);
-    parser.computeFirst();
-    parser.computeFollow();
-    parser.buildParseTable();
-
-    vector<Token> tokens;
-    ifstream tokenFile(argv[2]);
-    string line;
-    while (getline(tokenFile, line)) {
-        stringstream ss(line);
-        Token tok;
-        ss >> tok.line >> tok.type >> tok.value;
-        tokens.push_back(tok);
-    }
-
-    parser.parseTokens(tokens, argv[3]);
-    return 0;
-}
+﻿#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <filesystem>
+#include <chrono>
+#include <random>
+#include <new>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <variant>
+#include <tuple>
+#include "StaticLL1.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+// Vector width of the token file scanner, fixed by the target the build
+// compiles for (-mavx2, /arch:AVX2); x86-64 always has SSE2. AVX2 builds
+// keep the SSE2 path too, for --self-test scanner.
+#if defined(__AVX2__)
+#define TOKEN_SCAN_AVX2
+#define TOKEN_SCAN_SSE2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TOKEN_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Grammar symbols are interned into small integer IDs when the grammar is
+// loaded. Terminals are numbered 0, 1, 2, ... and nonterminals are stored as
+// ~index, so both kinds can share the parse stack while each still indexes
+// its own tables densely.
+typedef int SymbolId;
+
+const SymbolId END_MARKER = 0;          // "$", always terminal 0
+const SymbolId NO_SYMBOL = INT_MAX;     // token type that is not in the grammar
+
+inline bool isTerminalId(SymbolId id) { return id >= 0; }
+inline int nonTerminalIndex(SymbolId id) { return ~id; }
+inline SymbolId nonTerminalId(int index) { return ~index; }
+
+struct Token {
+    int line;
+    string type;
+    string value;
+};
+
+// Bump allocator: hands out memory from a few large blocks and frees it all
+// at once when the owner is destroyed
+class Arena {
+public:
+    void* allocate(size_t size, size_t align);
+    template <class T>
+    T* allocateArray(size_t count) { return (T*)allocate(count * sizeof(T), alignof(T)); }
+    string_view copy(string_view text);
+
+private:
+    vector<unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    size_t remaining = 0;
+    size_t nextBlockSize = 64 * 1024;
+};
+
+// Non-owning view of a symbol sequence stored in an Arena or a table file
+struct SymbolSpan {
+    const SymbolId* first = nullptr;
+    uint32_t count = 0;
+
+    const SymbolId* begin() const { return first; }
+    const SymbolId* end() const { return first + count; }
+    reverse_iterator<const SymbolId*> rbegin() const { return reverse_iterator<const SymbolId*>(end()); }
+    reverse_iterator<const SymbolId*> rend() const { return reverse_iterator<const SymbolId*>(begin()); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    SymbolId operator[](size_t i) const { return first[i]; }
+};
+
+struct GrammarRule {
+    SymbolId lhs;
+    SymbolSpan rhs;   // empty for an epsilon production
+};
+
+// Parse table cells hold an index into the grammar, NO_PRODUCTION for errors
+typedef uint16_t ProductionIndex;
+const ProductionIndex NO_PRODUCTION = 0xFFFF;
+
+// Contiguous [nonterminal][terminal] parse table. cells points at storage,
+// or straight into a mapped table file (see LL1Parser::loadTables).
+struct ParseTable {
+    int rows = 0, columns = 0;
+    vector<ProductionIndex> storage;
+    const ProductionIndex* cells = nullptr;
+
+    void reset(int nonTerminals, int terminals) {
+        rows = nonTerminals;
+        columns = terminals;
+        storage.assign((size_t)rows * terminals, NO_PRODUCTION);
+        cells = storage.data();
+    }
+    void attach(const ProductionIndex* mapped, int nonTerminals, int terminals) {
+        rows = nonTerminals;
+        columns = terminals;
+        storage.clear();
+        cells = mapped;
+    }
+    // Grow to nonTerminals x terminals keeping every cell; a mapped table is
+    // copied into storage so it can be edited
+    void resize(int nonTerminals, int terminals) {
+        vector<ProductionIndex> grown((size_t)nonTerminals * terminals, NO_PRODUCTION);
+        for (int r = 0; r < rows; ++r) copy(cells + (size_t)r * columns, cells + (size_t)(r + 1) * columns, grown.begin() + (size_t)r * terminals);
+        rows = nonTerminals;
+        columns = terminals;
+        storage.swap(grown);
+        cells = storage.data();
+    }
+    ProductionIndex& at(SymbolId nonTerminal, SymbolId terminal) {
+        return storage[(size_t)nonTerminalIndex(nonTerminal) * columns + terminal];
+    }
+    // Token types outside the grammar (NO_SYMBOL) or naming a nonterminal
+    // never have an entry
+    ProductionIndex lookup(SymbolId nonTerminal, SymbolId terminal) const {
+        if ((unsigned)terminal >= (unsigned)columns) return NO_PRODUCTION;
+        return cells[(size_t)nonTerminalIndex(nonTerminal) * columns + terminal];
+    }
+};
+
+// Index of the lowest set bit of a non-zero word
+inline int lowestBit(uint64_t word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)word)) return (int)index;
+    _BitScanForward(&index, (unsigned long)(word >> 32));
+    return (int)index + 32;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+// Number of set bits in a word
+inline int bitCount(uint64_t word) {
+#if defined(_MSC_VER)
+    word -= (word >> 1) & 0x5555555555555555ull;
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((word * 0x0101010101010101ull) >> 56);
+#else
+    return __builtin_popcountll(word);
+#endif
+}
+
+// One fixed-width bitset over terminal IDs per row (FIRST/FOLLOW of each
+// nonterminal). The bit after the last terminal stands for epsilon.
+class TerminalSets {
+public:
+    void reset(int rows, int terminals) {
+        epsilon = terminals;
+        words = terminals / 64 + 1;
+        bits.assign((size_t)rows * words, 0);
+    }
+    // Grow to rows x terminals keeping every row; the epsilon bit moves to
+    // its new position after the last terminal
+    void resize(int rows, int terminals) {
+        TerminalSets grown;
+        grown.reset(rows, terminals);
+        int oldRows = words ? (int)(bits.size() / words) : 0;
+        for (int r = 0; r < oldRows; ++r) {
+            uint64_t* target = grown.row(r);
+            copy(row(r), row(r) + words, target);
+            if (!hasEpsilon(r)) continue;
+            clearBit(target, epsilon);
+            setBit(target, grown.epsilon);
+        }
+        *this = move(grown);
+    }
+    void clearRow(int r) { fill(row(r), row(r) + words, 0); }
+    int wordCount() const { return words; }
+    int epsilonBit() const { return epsilon; }
+    uint64_t* row(int r) { return &bits[(size_t)r * words]; }
+    const uint64_t* row(int r) const { return &bits[(size_t)r * words]; }
+    bool hasEpsilon(int r) const { return testBit(row(r), epsilon); }
+    // The whole matrix, for the table file
+    uint64_t* raw() { return bits.data(); }
+    size_t rawSize() const { return bits.size(); }
+
+    static bool testBit(const uint64_t* r, int bit) { return (r[bit / 64] >> (bit % 64)) & 1; }
+    // Set a bit in a row; true if it was clear
+    static bool setBit(uint64_t* r, int bit) {
+        uint64_t mask = uint64_t(1) << (bit % 64);
+        bool wasClear = !(r[bit / 64] & mask);
+        r[bit / 64] |= mask;
+        return wasClear;
+    }
+    static void clearBit(uint64_t* r, int bit) { r[bit / 64] &= ~(uint64_t(1) << (bit % 64)); }
+
+    // OR src into dst without carrying src's epsilon bit; true if dst grew
+    bool unionWithoutEpsilon(uint64_t* dst, const uint64_t* src) const {
+        uint64_t changed = 0;
+        for (int w = 0; w < words; ++w) {
+            uint64_t add = src[w] & ~dst[w];
+            if (w == epsilon / 64) add &= ~(uint64_t(1) << (epsilon % 64));
+            dst[w] |= add;
+            changed |= add;
+        }
+        return changed != 0;
+    }
+
+    // Call f(terminal) for every terminal bit set in a row
+    template <class F>
+    void forEachTerminal(const uint64_t* r, F f) const {
+        for (int w = 0; w < words; ++w) {
+            for (uint64_t bitsLeft = r[w]; bitsLeft; bitsLeft &= bitsLeft - 1) {
+                int bit = w * 64 + lowestBit(bitsLeft);
+                if (bit != epsilon) f((SymbolId)bit);
+            }
+        }
+    }
+
+private:
+    int epsilon = 0, words = 0;
+    vector<uint64_t> bits;
+};
+
+// Seeds NameHash::build tries; a seed fails only when two names of one
+// bucket share a slot, which for a good seed is rare
+const int NAME_HASH_SEEDS = 64;
+
+// Perfect hash over a fixed set of names, built by hash and displace: the
+// hash of a name picks a bucket, and the displacement chosen for that bucket
+// when the table is built moves all of its names to distinct free slots. A
+// lookup is one hash and one name comparison, with no probing.
+class NameHash {
+public:
+    // The names must outlive the table. False, leaving the table empty, if
+    // no seed up to NAME_HASH_SEEDS places every name.
+    bool build(const vector<pair<string_view, SymbolId>>& names);
+    size_t size() const { return count; }
+    SymbolId find(string_view name) const {
+        if (slots.empty()) return NO_SYMBOL;
+        uint64_t h = hash(name, seed);
+        const Slot& slot = slots[((uint32_t)h ^ displacement[(h >> 32) & bucketMask]) & slotMask];
+        return slot.name == name ? slot.id : NO_SYMBOL;
+    }
+
+private:
+    struct Slot {
+        string_view name;
+        SymbolId id = NO_SYMBOL;
+    };
+    static uint64_t load(const char* p, size_t bytes) {
+        uint64_t word = 0;
+        memcpy(&word, p, bytes);
+        return word;
+    }
+    // Reads every byte of names up to 16 long with at most two
+    // fixed-size loads, none of them past the name. The seed goes in
+    // before any mixing, so no two names collide under every seed.
+    static uint64_t hash(string_view name, uint64_t seed) {
+        const char* p = name.data();
+        size_t n = name.size();
+        uint64_t a = seed, b = 0;
+        if (n >= 8) {
+            a ^= load(p, 8);
+            b = load(p + n - 8, 8);
+            for (size_t i = 8; i + 8 < n; i += 8) a = (a * 0x9E3779B97F4A7C15ull) ^ load(p + i, 8);
+        }
+        else if (n >= 4) {
+            a ^= load(p, 4);
+            b = load(p + n - 4, 4);
+        }
+        else if (n > 0) {
+            a ^= (uint64_t)(unsigned char)p[0] | (uint64_t)(unsigned char)p[n / 2] << 8 | (uint64_t)(unsigned char)p[n - 1] << 16;
+        }
+        uint64_t h = a * 0x9E3779B97F4A7C15ull;
+        h = (h ^ (h >> 29) ^ n) * 0xFF51AFD7ED558CCDull;
+        h = (h ^ (h >> 32) ^ b) * 0xC4CEB9FE1A85EC53ull;
+        return h ^ (h >> 29);
+    }
+
+    vector<Slot> slots;
+    vector<uint32_t> displacement;      // per bucket, XORed into the slot
+    uint64_t seed = 0;
+    uint32_t slotMask = 0, bucketMask = 0;
+    size_t count = 0;
+};
+
+// Maps symbol names to IDs and back. Terminal 0 is the "$" end marker; it
+// has no entry in ids, so input tokens can never match it by name.
+class SymbolTable {
+public:
+    SymbolTable() { terminalNames.push_back("$"); }
+    SymbolId addTerminal(string_view name);
+    SymbolId addNonTerminal(string_view name);
+    SymbolId find(string_view name) const;
+    string_view name(SymbolId id) const;
+    int terminalCount() const { return (int)terminalNames.size(); }
+    int nonTerminalCount() const { return (int)nonTerminalNames.size(); }
+    // Have find() use a perfect hash over the names added so far; names
+    // added later are looked up in the map until the next call
+    void buildPerfectHash();
+
+private:
+    Arena text;     // every name; the views below and the ids keys point here
+    vector<string_view> terminalNames, nonTerminalNames;
+    unordered_map<string_view, SymbolId> ids;
+    NameHash perfectHash;
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string& path);
+    void close();
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+};
+
+// A token parsed in place: the type is already a terminal ID and the value
+// points into the mapped file
+struct TokenRef {
+    int line;
+    SymbolId type;
+    string_view value;
+};
+
+// Token file of "line type value" records, or the binary form written by
+// convertTokenFile, read through a memory mapping without copying any
+// text. Records stay valid while the TokenFile lives.
+class TokenFile {
+public:
+    bool open(const string& path, const SymbolTable& symbols);
+    // Split records given as text, e.g. sent inline to --serve; the tokens
+    // point into the TokenFile's own copy of it
+    void assign(string records, const SymbolTable& symbols);
+    size_t size() const { return tokens.size(); }
+    const TokenRef* data() const { return tokens.data(); }
+
+private:
+    bool openBinary(const SymbolTable& symbols);
+    void split(const char* data, size_t size, const SymbolTable& symbols);
+
+    MappedFile file;
+    string text;
+    vector<TokenRef> tokens;
+};
+
+class ParseSession;
+class ParseTracer;
+
+// Two productions competing for one parse table cell. The one added later
+// (kept) ends up in the table, as the original last-wins construction did.
+struct TableConflict {
+    SymbolId nonTerminal, terminal;
+    ProductionIndex kept, replaced;
+    bool keptByFollow, replacedByFollow;    // entered through FOLLOW(lhs) as a nullable RHS
+};
+
+// One node of a parse tree. The children of a node are the childCount
+// consecutive nodes from firstChild; terminals and epsilon expansions have
+// none. Tokens [firstToken, firstToken + tokenCount) are the node's span.
+struct ParseNode {
+    SymbolId symbol;
+    ProductionIndex production;     // expansion used, NO_PRODUCTION for terminals
+    uint32_t firstChild, childCount;
+    uint32_t firstToken, tokenCount;
+};
+
+// Parse tree in one node pool, node 0 being the start symbol. After a
+// failed parse it holds the part built before the error.
+struct ParseTree {
+    vector<ParseNode> nodes;
+};
+
+// Wall time of each table-building phase and the fixpoint work done,
+// readable through LL1Parser::getStats()
+struct BuildStats {
+    uint64_t loadGrammarNs = 0, rewriteGrammarNs = 0, reduceGrammarNs = 0, computeFirstNs = 0, computeFollowNs = 0;
+    uint64_t buildParseTableNs = 0, loadTablesNs = 0;
+    uint64_t firstIterations = 0, followIterations = 0;   // nonterminal evaluations
+};
+
+// Work done by one ParseSession, readable through ParseSession::getStats()
+struct ParseStats {
+    uint64_t expansions = 0, matches = 0;
+    size_t maxStackDepth = 0;
+    size_t errors = 0;      // syntax errors reported
+};
+
+// Adds the wall time of its scope to a nanosecond counter
+class PhaseTimer {
+public:
+    explicit PhaseTimer(uint64_t& total) : total(total), startTime(chrono::steady_clock::now()) {}
+    ~PhaseTimer() { total += (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - startTime).count(); }
+
+private:
+    uint64_t& total;
+    chrono::steady_clock::time_point startTime;
+};
+
+// Destination of syntax error reports. A session hands over each report as
+// one complete line; a parse without errors writes nothing.
+class DiagnosticSink {
+public:
+    virtual ~DiagnosticSink() = default;
+    virtual void write(string_view text) = 0;
+};
+
+// Keeps the reports in memory, e.g. for one file of a batch
+class BufferedSink : public DiagnosticSink {
+public:
+    void write(string_view text) override { buffer += text; }
+    const string& text() const { return buffer; }
+    void clear() { buffer.clear(); }
+
+private:
+    string buffer;
+};
+
+// Writes to a file that is only created by the first report, so a
+// successful parse neither creates nor truncates it
+class LazyFileSink : public DiagnosticSink {
+public:
+    explicit LazyFileSink(string path) : path(move(path)) {}
+    void write(string_view text) override {
+        if (!file.is_open()) file.open(path);
+        file.write(text.data(), text.size());
+    }
+
+private:
+    string path;
+    ofstream file;
+};
+
+// Forwards reports to a stream owned by the caller
+class StreamSink : public DiagnosticSink {
+public:
+    explicit StreamSink(ostream& out) : out(out) {}
+    void write(string_view text) override { out.write(text.data(), text.size()); }
+
+private:
+    ostream& out;
+};
+
+// Where LL1Parser::parseChunked may split a token stream: after any token
+// of type terminal, where the parse is expected to go on with the restart
+// symbols (in RHS order) on top of the stack, e.g. after ';' in
+// "L -> S ; L" with restart L
+struct SyncPoint {
+    SymbolId terminal = NO_SYMBOL;
+    vector<SymbolId> restart;
+};
+
+// Symbols LL1Parser::reduceGrammar removed, by name: nonterminals that
+// derive no terminal string, those the start symbol cannot reach, and
+// terminals left on no right-hand side
+struct GrammarReduction {
+    vector<string> unproductive, unreachable, terminals;
+    size_t productions = 0;
+};
+
+// Nonterminals LL1Parser::rewriteGrammar changed, by name, and the ones
+// it added
+struct GrammarRewrite {
+    vector<string> leftRecursive, leftFactored, added;
+};
+
+class LL1Parser {
+private:
+    vector<GrammarRule> grammar;
+    SymbolTable symbols;
+    TerminalSets firstSet, followSet;   // rows indexed by nonterminal index
+    ParseTable parseTable;
+    SymbolId startSymbol = NO_SYMBOL;
+    BuildStats stats;
+    Arena rhsArena;     // RHS arrays of the productions in grammar
+    bool ebnf = false;
+    int analysisThreads = 0;
+    size_t errorLimit = 1;
+    bool strict = false;
+    vector<TableConflict> conflicts;
+
+public:
+    // Treat { ... } and [ ... ] in grammar files as repetition and option
+    void setEbnf(bool enabled) { ebnf = enabled; }
+    // Worker threads for computeFirst/computeFollow; 0 picks one per core
+    // for large grammars and a single thread otherwise
+    void setAnalysisThreads(int threads) { analysisThreads = threads; }
+    // Errors a parse reports before it stops, for sessions created after
+    // this; above 1 the parser recovers from each error (see
+    // ParseSession::recover), 0 means no limit
+    void setErrorLimit(size_t limit) { errorLimit = limit ? limit : SIZE_MAX; }
+    // Make buildParseTable throw, and loadTables refuse a cached table, when
+    // the grammar is not LL(1)
+    void setStrict(bool enabled) { strict = enabled; }
+    void loadGrammar(const string& filename);
+    // Same as loadGrammar, from text already in memory
+    void loadGrammarText(string_view text);
+    // Remove the unproductive nonterminals, then every symbol unreachable
+    // from the start symbol, with their productions, and renumber the rest
+    // densely in their original order. The start symbol is always kept.
+    // Call after loadGrammar and before computeFirst.
+    GrammarReduction reduceGrammar();
+    // Eliminate left recursion, then left-factor, so that naturally written
+    // grammars such as "E -> E + T | T" get an LL(1) form like
+    // grammar5.txt's. Helper nonterminals are named after the one they come
+    // from plus primes (E', E'', ...), skipping names in use, so the result
+    // only depends on the grammar. Left recursion through a nullable prefix
+    // is left alone. Call after loadGrammar and before computeFirst.
+    GrammarRewrite rewriteGrammar();
+    void computeFirst();
+    void computeFollow();
+    void buildParseTable();
+    bool parseTokens(const vector<Token>& tokens, const string& outputErrFile, ParseStats* parseStats = nullptr, ParseTree* tree = nullptr, ParseTracer* tracer = nullptr) const;
+    bool parseTokens(const TokenFile& tokens, const string& outputErrFile, ParseStats* parseStats = nullptr, ParseTree* tree = nullptr, ParseTracer* tracer = nullptr) const;
+    // Parse chunks of the tokens that start after sync.terminal on threads
+    // of their own, each assuming sync.restart on top of the stack, then
+    // join them in order. Where a chunk's assumption does not hold or it
+    // meets an error, parsing goes on sequentially from the chunk's start,
+    // so the result and errors are those of a sequential parse.
+    bool parseChunked(const TokenRef* tokens, size_t count, DiagnosticSink& errors, const SyncPoint& sync, int jobs, ParseStats* parseStats = nullptr) const;
+    ParseSession beginParse(const string& outputErrFile) const;
+    ParseSession beginParse(ostream& errors) const;
+    ParseSession beginParse(DiagnosticSink& errors) const;
+    const SymbolTable& getSymbols() const { return symbols; }
+    size_t productionCount() const { return grammar.size(); }
+    const BuildStats& getStats() const { return stats; }
+    // Cells of the table claimed by more than one production
+    const vector<TableConflict>& getConflicts() const { return conflicts; }
+    void writeConflicts(ostream& out) const;
+    // Approximate bytes held by the grammar and tables, for cache budgets
+    size_t memoryUsage() const;
+    // Write a standalone C++ recursive-descent parser for the current table
+    // in namespace name: one function per nonterminal that switches on the
+    // lookahead terminal, accepting and reporting exactly as ParseSession
+    // does with an error limit of 1
+    void writeRecursiveDescent(ostream& out, const string& name) const;
+    string productionText(ProductionIndex production) const;
+    bool saveTables(const string& filename, uint64_t grammarHash) const;
+    bool loadTables(const string& filename, uint64_t grammarHash);
+    // Edit the grammar of a built parser. Only the FIRST and FOLLOW sets and
+    // table rows that can depend on the edited nonterminal are recomputed,
+    // along with their conflicts; strict mode does not apply to edits. The
+    // bookkeeping around them is still linear in the grammar: every edit
+    // rebuilds the productions-by-nonterminal lists and the suffix FIRST
+    // sets, and a removal also rebuilds the push sequences and renumbers
+    // the whole table. --self-test edits checks edits against full builds.
+    // RHS names follow the grammar file rules ('quoted' names are terminals,
+    // "epsilon" is skipped), except that an unknown lower-case name is a
+    // terminal. New productions go last, so they win table conflicts as if
+    // appended to the file. False if lhs is a terminal or, on removal, no
+    // such production exists.
+    bool addProduction(const string& lhs, const vector<string>& rhs);
+    bool removeProduction(const string& lhs, const vector<string>& rhs);
+
+private:
+    friend class ParseSession;
+    friend class LALRParser;
+    friend class TokenGenerator;
+    friend string describeAnalysis(const LL1Parser& parser);
+    MappedFile tableFile;   // backs parseTable after loadTables
+    // RHS of every production in push order, as one pool:
+    // production p occupies [pushStart[p], pushStart[p + 1])
+    vector<SymbolId> pushSymbols;
+    vector<uint32_t> pushStart;
+    bool addFirstOf(SymbolSpan sequence, size_t from, uint64_t* out);
+    // FIRST(rhs[i..]) of production p for every i <= rhs.size(), entry
+    // suffixStart[p] + i, built by buildSuffixFirst once FIRST has
+    // converged. A suffix starting with a nullable nonterminal that is not
+    // last has a row of its own in suffixSets; any other is the FIRST of
+    // its first symbol alone, and the empty suffix has none.
+    struct SuffixFirst {
+        SymbolId symbol;    // first symbol, NO_SYMBOL for the empty suffix
+        uint32_t row;       // row of suffixSets, or NO_SUFFIX_ROW
+        bool nullable;
+    };
+    static const uint32_t NO_SUFFIX_ROW = UINT32_MAX;
+    vector<SuffixFirst> suffixFirst;
+    vector<uint32_t> suffixStart;
+    TerminalSets suffixSets;
+    void buildSuffixFirst();
+    const SuffixFirst& firstOfSuffix(size_t production, size_t from) const { return suffixFirst[suffixStart[production] + from]; }
+    bool unionFirstOf(const SuffixFirst& suffix, uint64_t* out) const;
+    bool firstContains(const SuffixFirst& suffix, SymbolId terminal) const;
+    template <class F> void forEachFirst(const SuffixFirst& suffix, F f) const;
+    void addTableEntries(size_t production);
+    void recordConflict(SymbolId terminal, ProductionIndex kept, bool keptByFollow, ProductionIndex replaced);
+    void updateAfterEdit(const GrammarRule& edited, bool added);
+    // Productions by LHS and by RHS nonterminal, rebuilt by every edit;
+    // kept as members so the inner vectors reuse their capacity
+    vector<vector<int>> productionsOf, occurrences;
+    bool isTerminal(SymbolId symbol) const { return isTerminalId(symbol); }
+    void buildPushSequences();
+    int analysisWorkers() const;
+};
+
+// Bottom of a speculative session's stack, standing for the unknown part.
+// No token type equals it, so reaching it always ends in recover().
+const SymbolId SPECULATION_BASE = INT_MAX - 1;
+// Fewest tokens parseChunked hands to one chunk
+const size_t PARSE_CHUNK_MIN_TOKENS = 1 << 16;
+
+// Initial parse stack capacity; deeper inputs grow it geometrically
+const size_t PARSE_STACK_RESERVE = 1024;
+// Parse tree nodes reserved per expected token; typical expression
+// grammars expand two to three nonterminals for every token they match
+const size_t PARSE_TREE_NODES_PER_TOKEN = 4;
+
+// Steps a ParseTracer ring holds; a full ring makes the parser wait for
+// the drain thread
+const size_t TRACE_RING_STEPS = 1 << 16;
+// Steps dumped before each syntax error unless --trace-last says otherwise
+const size_t TRACE_HISTORY_STEPS = 16;
+// How long the drain thread sleeps when the ring is empty
+const int TRACE_DRAIN_IDLE_US = 200;
+// Formatted trace text collected before each write
+const size_t TRACE_WRITE_BYTES = 1 << 16;
+
+// One parser step: top expanded by production with lookahead as the next
+// token, or matched by it when production is NO_PRODUCTION. Lines are -1
+// at the end of input, as in error reports.
+struct TraceStep {
+    SymbolId top, lookahead;
+    int line;
+    ProductionIndex production;
+};
+
+// Records the steps of one ParseSession at a time in a fixed-size
+// single-producer ring. Recording a step is a store and an index update;
+// a drain thread formats the steps to an optional stream, away from the
+// parse loop, and keeps the last few for error reports.
+class ParseTracer {
+public:
+    // Write every step to out unless it is null, keeping the last history
+    // steps for writeHistory. Productions are shown as they are now.
+    ParseTracer(const LL1Parser& parser, ostream* out, size_t history);
+    ~ParseTracer();
+    ParseTracer(const ParseTracer&) = delete;
+    ParseTracer& operator=(const ParseTracer&) = delete;
+    void record(SymbolId top, SymbolId lookahead, int line, ProductionIndex production) {
+        uint64_t next = head.load(memory_order_relaxed);
+        if (next - drainedTail >= TRACE_RING_STEPS) waitForSpace(next);
+        ring[next & (TRACE_RING_STEPS - 1)] = TraceStep{ top, lookahead, line, production };
+        head.store(next + 1, memory_order_release);
+    }
+    // Append the last steps recorded so far to text, oldest first, once
+    // the drain thread has caught up. Call from the recording thread.
+    void writeHistory(string& text);
+
+private:
+    void waitForSpace(uint64_t next);
+    void drain();
+    void format(string& text, uint64_t step, const TraceStep& record) const;
+
+    const LL1Parser& parser;
+    ostream* out;
+    vector<string> productionTexts;
+    vector<TraceStep> ring, history;    // history[step % size] once drained
+    alignas(64) atomic<uint64_t> head{ 0 };     // steps recorded
+    alignas(64) atomic<uint64_t> tail{ 0 };     // steps drained
+    uint64_t drainedTail = 0;   // the recording thread's last look at tail
+    atomic<bool> stopping{ false };
+    thread drainer;
+};
+
+// Incremental parse over tokens that arrive in batches, e.g. from a lexer
+// running alongside. Only the parse stack and the last token are kept
+// between feed() calls, so memory does not grow with the input.
+class ParseSession {
+public:
+    ParseSession(const LL1Parser& parser, const string& outputErrFile);
+    ParseSession(const LL1Parser& parser, ostream& errors);
+    ParseSession(const LL1Parser& parser, DiagnosticSink& errors);
+    ParseSession(const ParseSession&) = delete;
+    ParseSession& operator=(const ParseSession&) = delete;
+    bool feed(const Token* tokens, size_t count);
+    bool feed(const TokenRef* tokens, size_t count);
+    bool feed(const vector<Token>& tokens) { return feed(tokens.data(), tokens.size()); }
+    bool finish();
+    bool failed() const { return stats.errors > 0; }
+    const ParseStats& getStats() const { return stats; }
+    // Record the parse tree into tree while parsing. Call before the first
+    // feed(); spans are complete once finish() returns.
+    void buildTree(ParseTree& tree, size_t expectedTokens = 0);
+    // Record every expansion and match into tracer, which dumps its last
+    // steps before each reported error. Call before the first feed().
+    void trace(ParseTracer& output) { tracer = &output; }
+    void setErrorLimit(size_t limit) { errorLimit = limit ? limit : SIZE_MAX; }
+    // Parse as if restart (in RHS order) were on top of an unknown stack; a
+    // session that would need to look below it stops as underflowed()
+    void speculate(const vector<SymbolId>& restart);
+    bool underflowed() const { return underflow; }
+    // Take over the state a speculative session reached after the tokens
+    // fed to it, if this session has no errors and its stack ends with the
+    // restart symbols that session assumed
+    bool adopt(const ParseSession& chunk, const vector<SymbolId>& restart);
+
+private:
+    enum class Recovery { Stop, Retry, Skip };
+    template <bool BuildTree> Recovery recover(SymbolId top, SymbolId type, int line, string_view value);
+    template <bool BuildTree, bool Trace, class T> bool feedBatch(const T* tokens, size_t count);
+    template <bool BuildTree, bool Trace> bool shift(SymbolId type, int line, string_view value);
+    template <bool BuildTree> void expand(ProductionIndex production);
+    template <bool BuildTree, bool Trace> bool finishAs();
+    void reportUnexpected(int line, string_view value);
+    void reportExpected(int line, string_view expected, string_view value);
+    void start();
+    void finishTree();
+
+    const LL1Parser& parser;
+    vector<SymbolId> parseStack;    // top is back()
+    variant<monostate, LazyFileSink, StreamSink> ownedSink;
+    DiagnosticSink& sink;       // ownedSink, or a sink owned by the caller
+    string report;              // the report being written
+    bool error = false;     // stopped: no further input is parsed
+    bool underflow = false; // a speculative session reached SPECULATION_BASE
+    size_t errorLimit;
+    uint64_t matchesAtLastError = 0;
+    int lastLine = -1;      // last token fed, reported for errors at "$"
+    string lastValue = "$";
+    ParseStats stats;
+    ParseTree* tree = nullptr;
+    vector<uint32_t> nodeStack;     // tree node of each parseStack entry
+    ParseTracer* tracer = nullptr;
+};
+
+// Allocate size bytes; a request that does not fit starts a new block
+void* Arena::allocate(size_t size, size_t align) {
+    size_t padding = (align - (uintptr_t)cursor % align) % align;
+    if (size + padding > remaining) {
+        size_t blockSize = max(nextBlockSize, size + align);
+        blocks.emplace_back(new char[blockSize]);
+        cursor = blocks.back().get();
+        remaining = blockSize;
+        nextBlockSize *= 2;
+        padding = (align - (uintptr_t)cursor % align) % align;
+    }
+    char* result = cursor + padding;
+    cursor += padding + size;
+    remaining -= padding + size;
+    return result;
+}
+
+// Copy a string into the arena
+string_view Arena::copy(string_view text) {
+    if (text.empty()) return string_view();
+    char* bytes = allocateArray<char>(text.size());
+    memcpy(bytes, text.data(), text.size());
+    return string_view(bytes, text.size());
+}
+
+// Add a terminal, or return its ID if it already exists
+SymbolId SymbolTable::addTerminal(string_view name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) return it->second;
+    SymbolId id = (SymbolId)terminalNames.size();
+    terminalNames.push_back(text.copy(name));
+    ids[terminalNames.back()] = id;
+    return id;
+}
+
+// Add a nonterminal, or return its ID if it already exists
+SymbolId SymbolTable::addNonTerminal(string_view name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) return it->second;
+    SymbolId id = nonTerminalId((int)nonTerminalNames.size());
+    nonTerminalNames.push_back(text.copy(name));
+    ids[nonTerminalNames.back()] = id;
+    return id;
+}
+
+// Look up a symbol by name, NO_SYMBOL if the grammar does not use it
+SymbolId SymbolTable::find(string_view name) const {
+    if (perfectHash.size() == ids.size()) return perfectHash.find(name);
+    auto it = ids.find(name);
+    return it == ids.end() ? NO_SYMBOL : it->second;
+}
+
+void SymbolTable::buildPerfectHash() {
+    perfectHash.build(vector<pair<string_view, SymbolId>>(ids.begin(), ids.end()));
+}
+
+// Slots are twice the names rounded up to a power of two and buckets hold
+// two names on average. Buckets are placed largest first, each with the
+// first displacement that finds free slots for all of its names; the seed
+// changes only if two names of a bucket share their undisplaced slot.
+bool NameHash::build(const vector<pair<string_view, SymbolId>>& names) {
+    count = names.size();
+    size_t slotCount = 2;
+    while (slotCount < 2 * count) slotCount *= 2;
+    size_t bucketCount = max<size_t>(1, slotCount / 4);
+    slotMask = (uint32_t)(slotCount - 1);
+    bucketMask = (uint32_t)(bucketCount - 1);
+    vector<uint64_t> hashes(count);
+    vector<vector<uint32_t>> buckets(bucketCount);
+    vector<uint32_t> order(bucketCount);
+    vector<char> used(slotCount);
+    bool placed = false;
+    seed = 0x243F6A8885A308D3ull;
+    for (int attempt = 0; attempt < NAME_HASH_SEEDS && !placed; ++attempt) {
+        if (attempt > 0) seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        for (vector<uint32_t>& bucket : buckets) bucket.clear();
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = hash(names[i].first, seed);
+            buckets[(hashes[i] >> 32) & bucketMask].push_back((uint32_t)i);
+        }
+        for (size_t b = 0; b < bucketCount; ++b) order[b] = (uint32_t)b;
+        stable_sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) { return buckets[x].size() > buckets[y].size(); });
+        displacement.assign(bucketCount, 0);
+        fill(used.begin(), used.end(), 0);
+        placed = true;
+        for (uint32_t b : order) {
+            const vector<uint32_t>& bucket = buckets[b];
+            if (bucket.empty()) break;
+            placed = false;
+            for (uint32_t d = 0; d < slotCount && !placed; ++d) {
+                size_t taken = 0;
+                while (taken < bucket.size() && !used[((uint32_t)hashes[bucket[taken]] ^ d) & slotMask]) {
+                    used[((uint32_t)hashes[bucket[taken]] ^ d) & slotMask] = 1;
+                    ++taken;
+                }
+                placed = taken == bucket.size();
+                if (placed) displacement[b] = d;
+                else while (taken-- > 0) used[((uint32_t)hashes[bucket[taken]] ^ d) & slotMask] = 0;
+            }
+            if (!placed) break;
+        }
+    }
+    if (!placed) {
+        count = 0;
+        slots.clear();
+        return false;
+    }
+    slots.assign(slotCount, Slot());
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t h = hashes[i];
+        slots[((uint32_t)h ^ displacement[(h >> 32) & bucketMask]) & slotMask] = Slot{ names[i].first, names[i].second };
+    }
+    return true;
+}
+
+// Name of a symbol, for diagnostics
+string_view SymbolTable::name(SymbolId id) const {
+    if (id == NO_SYMBOL) return string_view();
+    return isTerminalId(id) ? terminalNames[id] : nonTerminalNames[nonTerminalIndex(id)];
+}
+
+// Map a file read-only; an empty file opens with size() == 0
+bool MappedFile::open(const string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    bool ok = GetFileSizeEx(handle, &fileSize) != 0;
+    if (ok && fileSize.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (mapping) CloseHandle(mapping);
+        ok = view != nullptr;
+        if (ok) {
+            bytes = (const char*)view;
+            length = (size_t)fileSize.QuadPart;
+        }
+    }
+    CloseHandle(handle);
+    return ok;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0;
+    if (ok && info.st_size > 0) {
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;  // every page is read, so fault them in at once
+#endif
+        void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, flags, fd, 0);
+        ok = view != MAP_FAILED;
+        if (ok) {
+            bytes = (const char*)view;
+            length = (size_t)info.st_size;
+            madvise(view, length, MADV_SEQUENTIAL);
+        }
+    }
+    ::close(fd);
+    return ok;
+#endif
+}
+
+// Release the mapping
+void MappedFile::close() {
+    if (!bytes) return;
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+#else
+    munmap((void*)bytes, length);
+#endif
+    bytes = nullptr;
+    length = 0;
+}
+
+// Bit masks of the whitespace (' ', '\t', '\r', '\v', '\f') and '\n' bytes
+// of a buffer, 64 bytes per block, classified with AVX2 or SSE2 compares
+// where the build targets them. Bytes past the end count as '\n'. Every
+// path the target allows is compiled, so --self-test scanner can check
+// each against the others.
+struct SeparatorBlock {
+    uint64_t spaces = 0, newlines = 0;
+
+    SeparatorBlock() = default;
+    SeparatorBlock(const char* data, size_t size, size_t base) {
+        if (base + 64 <= size) {
+            classify(data + base);
+            return;
+        }
+        char tail[64];
+        memset(tail, '\n', sizeof(tail));
+        if (size > base) memcpy(tail, data + base, size - base);
+        classify(tail);
+    }
+
+    void classify(const char* p) {
+#if defined(TOKEN_SCAN_AVX2)
+        classifyAVX2(p);
+#elif defined(TOKEN_SCAN_SSE2)
+        classifySSE2(p);
+#else
+        classifyScalar(p);
+#endif
+    }
+
+#if defined(TOKEN_SCAN_AVX2)
+    void classifyAVX2(const char* p) {
+        for (int part = 0; part < 2; ++part) {
+            __m256i bytes = _mm256_loadu_si256((const __m256i*)(p + 32 * part));
+            __m256i fromTab = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+            __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(fromTab, _mm256_set1_epi8('\r' - '\t')), fromTab);
+            __m256i newline = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'));
+            __m256i space = _mm256_andnot_si256(newline, _mm256_or_si256(control, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '))));
+            spaces |= (uint64_t)(uint32_t)_mm256_movemask_epi8(space) << (32 * part);
+            newlines |= (uint64_t)(uint32_t)_mm256_movemask_epi8(newline) << (32 * part);
+        }
+    }
+#endif
+#if defined(TOKEN_SCAN_SSE2)
+    void classifySSE2(const char* p) {
+        for (int part = 0; part < 4; ++part) {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(p + 16 * part));
+            __m128i fromTab = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+            __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(fromTab, _mm_set1_epi8('\r' - '\t')), fromTab);
+            __m128i newline = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'));
+            __m128i space = _mm_andnot_si128(newline, _mm_or_si128(control, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '))));
+            spaces |= (uint64_t)(uint32_t)_mm_movemask_epi8(space) << (16 * part);
+            newlines |= (uint64_t)(uint32_t)_mm_movemask_epi8(newline) << (16 * part);
+        }
+    }
+#endif
+    void classifyScalar(const char* p) {
+        for (int i = 0; i < 64; ++i) {
+            char c = p[i];
+            if (c == '\n') newlines |= uint64_t(1) << i;
+            else if (c == ' ' || (c >= '\t' && c <= '\r')) spaces |= uint64_t(1) << i;
+        }
+    }
+};
+
+// Line number of a token record: the leading digits of text[start, end),
+// negated after a '-'. Up to eight digits are converted at once when eight
+// bytes can be read; on x86, which the SIMD builds imply, the first digit
+// is the lowest byte of the word.
+static int parseLineNumber(const char* text, size_t start, size_t end, size_t size) {
+    bool negative = text[start] == '-';
+    start += negative;
+#if defined(TOKEN_SCAN_AVX2) || defined(TOKEN_SCAN_SSE2)
+    size_t length = end - start;
+    if (length >= 1 && length <= 8 && start + 8 <= size) {
+        uint64_t chunk;
+        memcpy(&chunk, text + start, 8);
+        chunk <<= (8 - length) * 8;
+        if (length < 8) chunk |= 0x3030303030303030ull >> (length * 8);     // leading '0's
+        if ((chunk & 0xF0F0F0F0F0F0F0F0ull) == 0x3030303030303030ull
+            && ((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) == 0x3030303030303030ull) {
+            uint64_t v = chunk - 0x3030303030303030ull;
+            v = v * 10 + (v >> 8);
+            v = ((v & 0x000000FF000000FFull) * 0x000F424000000064ull + ((v >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull) >> 32;
+            return negative ? -(int)v : (int)v;
+        }
+    }
+#endif
+    // Unsigned, so that numbers past INT_MAX wrap instead of overflowing
+    unsigned line = 0;
+    for (size_t i = start; i < end && text[i] >= '0' && text[i] <= '9'; ++i) line = line * 10 + (unsigned)(text[i] - '0');
+    return (int)(negative ? 0u - line : line);
+}
+
+// Split the "line type value" records of token file text in place and
+// call record(line, type, value) for each. Blank lines are skipped and a
+// line with only two fields has an empty value. Each 64-byte block is
+// classified once, and the starts and ends of its fields and its newlines
+// are then visited bit by bit, so the loop runs per field rather than per
+// byte. A last block padded with '\n' ends the final line even without a
+// newline.
+template <class Record>
+static void splitTokenRecords(const char* text, size_t size, Record record) {
+    size_t blocks = size / 64 + 1;
+    size_t starts[3], ends[3];      // number, type and value of the current line
+    int fields = 0;                 // fields of the line seen so far, up to 3
+    uint64_t previousSeparator = 1; // bit 63 of the previous block; a line start before the file
+    for (size_t b = 0; b < blocks; ++b) {
+        size_t base = b * 64;
+        SeparatorBlock block(text, size, base);
+        uint64_t separators = block.spaces | block.newlines;
+        uint64_t afterSeparator = (separators << 1) | previousSeparator;
+        previousSeparator = separators >> 63;
+        uint64_t fieldStarts = ~separators & afterSeparator;
+        uint64_t fieldEnds = separators & ~afterSeparator;
+        for (uint64_t events = fieldStarts | fieldEnds | block.newlines; events; events &= events - 1) {
+            int bit = lowestBit(events);
+            uint64_t mask = uint64_t(1) << bit;
+            size_t pos = base + bit;
+            if (fieldStarts & mask) {
+                if (fields < 3) starts[fields] = pos;
+                continue;
+            }
+            if ((fieldEnds & mask) && fields < 3) ends[fields++] = pos;
+            if (!(block.newlines & mask)) continue;
+            if (fields >= 2) {
+                record(parseLineNumber(text, starts[0], ends[0], size), string_view(text + starts[1], ends[1] - starts[1]),
+                    fields == 3 ? string_view(text + starts[2], ends[2] - starts[2]) : string_view(text + ends[1], 0));
+            }
+            fields = 0;
+        }
+    }
+}
+
+// Binary token files start with this header, followed by 8-byte aligned
+// sections: the type names (NUL terminated), the value table of (offset,
+// length) pairs into the pool, the records and the pool of distinct
+// values. Records are fixed width so they are read straight from the
+// mapping.
+struct TokenFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t typeCount;
+    uint64_t valueCount, tokenCount, recordCount;
+    uint64_t namesSize, poolSize;
+};
+
+// One token of a binary token file: indexes into the value table and the
+// type names, and the line as a change from the previous token's. A
+// record of type LINE_RECORD instead sets the line to its value, for
+// changes that do not fit the delta.
+struct TokenRecord {
+    uint32_t value;
+    uint16_t type;
+    int16_t lineDelta;
+};
+
+const uint16_t LINE_RECORD = 0xFFFF;
+
+const char TOKEN_FILE_MAGIC[8] = { 'L', 'L', '1', 'T', 'O', 'K', 'E', 'N' };
+const uint32_t TOKEN_FILE_VERSION = 1;
+
+// Map a token file, text or binary, and split every record in place.
+// Type names not in the grammar become NO_SYMBOL. A binary file has its
+// type names looked up once each; a malformed one fails with no tokens.
+bool TokenFile::open(const string& path, const SymbolTable& symbols) {
+    tokens.clear();
+    if (!file.open(path)) return false;
+    const char* text = file.data();
+    size_t size = file.size();
+    if (size >= sizeof(TokenFileHeader) && memcmp(text, TOKEN_FILE_MAGIC, sizeof(TOKEN_FILE_MAGIC)) == 0) {
+        return openBinary(symbols);
+    }
+    split(text, size, symbols);
+    return true;
+}
+
+void TokenFile::assign(string records, const SymbolTable& symbols) {
+    file.close();
+    text = move(records);
+    tokens.clear();
+    split(text.data(), text.size(), symbols);
+}
+
+void TokenFile::split(const char* data, size_t size, const SymbolTable& symbols) {
+    size_t lines = 0;
+    for (size_t b = 0; b < size / 64 + 1; ++b) lines += bitCount(SeparatorBlock(data, size, b * 64).newlines);
+    tokens.reserve(lines);
+    splitTokenRecords(data, size, [&](int line, string_view type, string_view value) {
+        tokens.push_back(TokenRef{ line, symbols.find(type), value });
+    });
+}
+
+// Read the sections of a mapped binary token file written by convertTokenFile
+bool TokenFile::openBinary(const SymbolTable& symbols) {
+    TokenFileHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    size_t offset = 0;
+    bool ok = header.version == TOKEN_FILE_VERSION && header.typeCount < LINE_RECORD
+        && header.valueCount <= file.size() && header.tokenCount <= header.recordCount && header.recordCount <= file.size();
+    auto section = [&](uint64_t size) -> const char* {
+        size_t start = offset;
+        if (!ok || size > file.size()) ok = false;
+        else offset += size + (8 - size % 8) % 8;
+        if (offset > file.size()) ok = false;
+        return ok ? file.data() + start : nullptr;
+    };
+    section(sizeof(header));
+    const char* names = section(header.namesSize);
+    const uint32_t* values = (const uint32_t*)section(header.valueCount * 2 * sizeof(uint32_t));
+    const char* records = section(header.recordCount * sizeof(TokenRecord));
+    const char* pool = section(header.poolSize);
+    if (!ok) return false;
+
+    vector<SymbolId> types;
+    types.reserve(header.typeCount);
+    const char* name = names;
+    const char* namesEnd = names + header.namesSize;
+    for (uint32_t t = 0; t < header.typeCount; ++t) {
+        const char* end = (const char*)memchr(name, '\0', namesEnd - name);
+        if (!end) return false;
+        types.push_back(symbols.find(string_view(name, end - name)));
+        name = end + 1;
+    }
+    for (uint64_t v = 0; v < header.valueCount; ++v) {
+        if (values[v * 2] > header.poolSize || values[v * 2 + 1] > header.poolSize - values[v * 2]) return false;
+    }
+
+    tokens.reserve(header.tokenCount);
+    int line = 0;
+    for (uint64_t i = 0; i < header.recordCount; ++i) {
+        TokenRecord record;
+        memcpy(&record, records + i * sizeof(TokenRecord), sizeof(record));
+        if (record.type == LINE_RECORD) {
+            line = (int32_t)record.value;
+            continue;
+        }
+        if (record.type >= header.typeCount || record.value >= header.valueCount) {
+            tokens.clear();
+            return false;
+        }
+        line += record.lineDelta;
+        tokens.push_back(TokenRef{ line, types[record.type], string_view(pool + values[record.value * 2], values[record.value * 2 + 1]) });
+    }
+    return true;
+}
+
+// Write a text token file in the binary format for --convert-tokens. Type
+// names and values are stored once each, in order of first use. Fails for
+// files with LINE_RECORD or more distinct types.
+bool convertTokenFile(const string& textPath, const string& binaryPath) {
+    MappedFile text;
+    if (!text.open(textPath)) return false;
+    string names, pool;
+    unordered_map<string_view, uint32_t> typeIndex, valueIndex;
+    vector<uint32_t> values;
+    vector<TokenRecord> records;
+    uint64_t tokenCount = 0;
+    int lastLine = 0;
+    splitTokenRecords(text.data(), text.size(), [&](int line, string_view type, string_view value) {
+        auto typeEntry = typeIndex.emplace(type, (uint32_t)typeIndex.size());
+        if (typeEntry.second) names.append(type) += '\0';
+        auto valueEntry = valueIndex.emplace(value, (uint32_t)valueIndex.size());
+        if (valueEntry.second) {
+            values.push_back((uint32_t)pool.size());
+            values.push_back((uint32_t)value.size());
+            pool.append(value);
+        }
+        int64_t delta = (int64_t)line - lastLine;
+        if (delta < INT16_MIN || delta > INT16_MAX) {
+            records.push_back(TokenRecord{ (uint32_t)line, LINE_RECORD, 0 });
+            delta = 0;
+        }
+        records.push_back(TokenRecord{ valueEntry.first->second, (uint16_t)typeEntry.first->second, (int16_t)delta });
+        lastLine = line;
+        ++tokenCount;
+    });
+    if (typeIndex.size() >= LINE_RECORD || pool.size() > UINT32_MAX) return false;
+
+    TokenFileHeader header = {};
+    memcpy(header.magic, TOKEN_FILE_MAGIC, sizeof(header.magic));
+    header.version = TOKEN_FILE_VERSION;
+    header.typeCount = (uint32_t)typeIndex.size();
+    header.valueCount = valueIndex.size();
+    header.tokenCount = tokenCount;
+    header.recordCount = records.size();
+    header.namesSize = names.size();
+    header.poolSize = pool.size();
+    ofstream out(binaryPath, ios::binary);
+    auto write = [&](const void* data, size_t size) {
+        static const char padding[8] = {};
+        out.write((const char*)data, size);
+        out.write(padding, (8 - size % 8) % 8);
+    };
+    write(&header, sizeof(header));
+    write(names.data(), names.size());
+    write(values.data(), values.size() * sizeof(uint32_t));
+    write(records.data(), records.size() * sizeof(TokenRecord));
+    write(pool.data(), pool.size());
+    return (bool)out;
+}
+
+// A grammar symbol as written; quoted ('x') names are always terminals
+struct GrammarWord {
+    string_view text;
+    bool quoted;
+};
+
+// Single-pass reader for grammar text. It splits the file buffer into
+// words in place and lowers '|' alternatives, and with EBNF enabled
+// { a } and [ a ], into plain productions whose symbols are still names:
+//   A -> x { y } [ z ]   becomes   A -> x A{1} A[2]
+//                                  A{1} -> y A{1} | epsilon
+//                                  A[2] -> z | epsilon
+struct GrammarReader {
+    struct Production {
+        string_view lhs;
+        size_t begin, end;      // range of words
+    };
+
+    bool ebnf = false;
+    vector<GrammarWord> words;              // RHS words of every production
+    vector<Production> productions;
+    unordered_set<string_view> lhsNames;
+    string_view start;                      // LHS of the first rule line
+    deque<string> helperNames;              // names of generated nonterminals
+    int helperCount = 0;
+
+    void read(string_view text);
+    void addProduction(string_view lhs, const vector<GrammarWord>& rhs);
+    bool lowerAlternatives(string_view lhs, const vector<GrammarWord>& line, size_t& pos, string_view close, const GrammarWord* tail);
+};
+
+// Split the text into lines and words. A line is "A -> alternatives"; a
+// line starting with "|" adds alternatives to the previous LHS. Other
+// lines, and lines with unbalanced brackets, are skipped.
+void GrammarReader::read(string_view text) {
+    if (text.substr(0, 3) == "\xEF\xBB\xBF") text.remove_prefix(3);
+    auto isSpace = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; };
+    vector<GrammarWord> line;
+    string_view currentLhs;
+    size_t p = 0;
+    while (p < text.size()) {
+        line.clear();
+        while (p < text.size() && text[p] != '\n') {
+            if (isSpace(text[p])) {
+                ++p;
+                continue;
+            }
+            size_t start = p;
+            while (p < text.size() && text[p] != '\n' && !isSpace(text[p])) ++p;
+            string_view word = text.substr(start, p - start);
+            bool quoted = word.size() >= 3 && word.front() == '\'' && word.back() == '\'';
+            line.push_back({ quoted ? word.substr(1, word.size() - 2) : word, quoted });
+        }
+        ++p;
+
+        size_t pos;
+        if (line.size() >= 3 && !line[1].quoted && line[1].text == "->") {
+            currentLhs = line[0].text;
+            pos = 2;
+        }
+        else if (line.size() >= 2 && !line[0].quoted && line[0].text == "|" && !currentLhs.empty()) {
+            pos = 1;
+        }
+        else continue;
+
+        size_t productionMark = productions.size(), wordMark = words.size();
+        if (!lowerAlternatives(currentLhs, line, pos, string_view(), nullptr)) {
+            productions.resize(productionMark);
+            words.resize(wordMark);
+            continue;
+        }
+        lhsNames.insert(currentLhs);
+        if (start.empty()) start = currentLhs;
+    }
+}
+
+void GrammarReader::addProduction(string_view lhs, const vector<GrammarWord>& rhs) {
+    productions.push_back({ lhs, words.size(), words.size() + rhs.size() });
+    words.insert(words.end(), rhs.begin(), rhs.end());
+}
+
+// Lower the alternatives in line[pos..] for lhs, up to the closing bracket
+// close (or the end of the line when close is empty). tail is appended to
+// every alternative, which makes a repetition helper right-recursive.
+// Returns false on unbalanced brackets.
+bool GrammarReader::lowerAlternatives(string_view lhs, const vector<GrammarWord>& line, size_t& pos, string_view close, const GrammarWord* tail) {
+    vector<GrammarWord> alternative;
+    while (true) {
+        bool atEnd = pos == line.size();
+        if (atEnd && !close.empty()) return false;
+        const GrammarWord* word = atEnd ? nullptr : &line[pos];
+        bool meta = word && !word->quoted;
+        if (atEnd || (meta && (word->text == "|" || word->text == close))) {
+            if (tail) alternative.push_back(*tail);
+            addProduction(lhs, alternative);
+            alternative.clear();
+            if (atEnd) return true;
+            ++pos;
+            if (word->text == close) return true;
+        }
+        else if (ebnf && meta && (word->text == "{" || word->text == "[")) {
+            bool repeat = word->text == "{";
+            ++pos;
+            helperNames.push_back(string(lhs) + (repeat ? "{" : "[") + to_string(++helperCount) + (repeat ? "}" : "]"));
+            GrammarWord helper = { helperNames.back(), false };
+            if (!lowerAlternatives(helper.text, line, pos, repeat ? "}" : "]", repeat ? &helper : nullptr)) return false;
+            addProduction(helper.text, vector<GrammarWord>());
+            lhsNames.insert(helper.text);
+            alternative.push_back(helper);
+        }
+        else if (ebnf && meta && (word->text == "}" || word->text == "]")) {
+            return false;
+        }
+        else {
+            alternative.push_back(*word);
+            ++pos;
+        }
+    }
+}
+
+// Load grammar rules from file
+void LL1Parser::loadGrammar(const string& filename) {
+    MappedFile file;
+    file.open(filename);
+    loadGrammarText(string_view(file.data(), file.size()));
+}
+
+void LL1Parser::loadGrammarText(string_view text) {
+    PhaseTimer timer(stats.loadGrammarNs);
+    GrammarReader reader;
+    reader.ebnf = ebnf;
+    reader.read(text);
+
+    // Intern every symbol: LHS names and capitalised names are nonterminals,
+    // everything else is a terminal. "epsilon" only marks an empty RHS.
+    // Names and RHS arrays are copied into arenas; rules only point there.
+    vector<SymbolId> rhs;
+    grammar.reserve(grammar.size() + reader.productions.size());
+    for (const GrammarReader::Production& production : reader.productions) {
+        GrammarRule rule;
+        rule.lhs = symbols.addNonTerminal(production.lhs);
+        rhs.clear();
+        for (size_t i = production.begin; i < production.end; ++i) {
+            const GrammarWord& sym = reader.words[i];
+            if (sym.quoted) rhs.push_back(symbols.addTerminal(sym.text));
+            else if (sym.text == "epsilon") continue;
+            else if (isupper((unsigned char)sym.text[0]) || reader.lhsNames.count(sym.text)) rhs.push_back(symbols.addNonTerminal(sym.text));
+            else rhs.push_back(symbols.addTerminal(sym.text));
+        }
+        SymbolId* stored = rhsArena.allocateArray<SymbolId>(rhs.size());
+        copy(rhs.begin(), rhs.end(), stored);
+        rule.rhs.first = stored;
+        rule.rhs.count = (uint32_t)rhs.size();
+        grammar.push_back(rule);
+    }
+    if (startSymbol == NO_SYMBOL && !reader.start.empty()) startSymbol = symbols.find(reader.start);
+    symbols.buildPerfectHash();
+    firstSet.reset(symbols.nonTerminalCount(), symbols.terminalCount());
+    followSet.reset(symbols.nonTerminalCount(), symbols.terminalCount());
+}
+
+// A production is productive once every nonterminal on its RHS is, and a
+// nonterminal once one of its productions is; each production counts its
+// RHS nonterminals not yet known to be productive. Reachability then only
+// follows productive productions.
+GrammarReduction LL1Parser::reduceGrammar() {
+    PhaseTimer timer(stats.reduceGrammarNs);
+    int count = symbols.nonTerminalCount();
+    vector<vector<int>> productionsOf(count), users(count);
+    vector<int> pending(grammar.size(), 0), worklist;
+    vector<char> productive(count, 0), reachable(count, 0);
+    auto markProductive = [&](int n) {
+        if (productive[n]) return;
+        productive[n] = 1;
+        worklist.push_back(n);
+    };
+    for (size_t p = 0; p < grammar.size(); ++p) {
+        productionsOf[nonTerminalIndex(grammar[p].lhs)].push_back((int)p);
+        for (SymbolId symbol : grammar[p].rhs) {
+            if (isTerminal(symbol)) continue;
+            users[nonTerminalIndex(symbol)].push_back((int)p);
+            ++pending[p];
+        }
+        if (pending[p] == 0) markProductive(nonTerminalIndex(grammar[p].lhs));
+    }
+    while (!worklist.empty()) {
+        int n = worklist.back();
+        worklist.pop_back();
+        for (int p : users[n]) {
+            if (--pending[p] == 0) markProductive(nonTerminalIndex(grammar[p].lhs));
+        }
+    }
+
+    vector<char> usedTerminals(symbols.terminalCount(), 0);
+    if (startSymbol != NO_SYMBOL) {
+        reachable[nonTerminalIndex(startSymbol)] = 1;
+        worklist.push_back(nonTerminalIndex(startSymbol));
+    }
+    while (!worklist.empty()) {
+        int n = worklist.back();
+        worklist.pop_back();
+        for (int p : productionsOf[n]) {
+            if (pending[p] > 0) continue;
+            for (SymbolId symbol : grammar[p].rhs) {
+                if (isTerminal(symbol)) usedTerminals[symbol] = 1;
+                else if (!reachable[nonTerminalIndex(symbol)]) {
+                    reachable[nonTerminalIndex(symbol)] = 1;
+                    worklist.push_back(nonTerminalIndex(symbol));
+                }
+            }
+        }
+    }
+
+    GrammarReduction reduction;
+    SymbolTable reduced;
+    vector<SymbolId> terminalIds(symbols.terminalCount(), END_MARKER), nonTerminalIds(count, NO_SYMBOL);
+    for (int t = 1; t < symbols.terminalCount(); ++t) {
+        if (usedTerminals[t]) terminalIds[t] = reduced.addTerminal(symbols.name(t));
+        else reduction.terminals.emplace_back(symbols.name(t));
+    }
+    for (int n = 0; n < count; ++n) {
+        if (reachable[n]) nonTerminalIds[n] = reduced.addNonTerminal(symbols.name(nonTerminalId(n)));
+        else (productive[n] ? reduction.unreachable : reduction.unproductive).emplace_back(symbols.name(nonTerminalId(n)));
+    }
+    vector<GrammarRule> kept;
+    for (size_t p = 0; p < grammar.size(); ++p) {
+        int lhs = nonTerminalIndex(grammar[p].lhs);
+        if (pending[p] > 0 || !reachable[lhs]) continue;
+        SymbolId* rhs = rhsArena.allocateArray<SymbolId>(grammar[p].rhs.size());
+        for (size_t i = 0; i < grammar[p].rhs.size(); ++i) {
+            SymbolId symbol = grammar[p].rhs[i];
+            rhs[i] = isTerminal(symbol) ? terminalIds[symbol] : nonTerminalIds[nonTerminalIndex(symbol)];
+        }
+        GrammarRule rule;
+        rule.lhs = nonTerminalIds[lhs];
+        rule.rhs.first = rhs;
+        rule.rhs.count = grammar[p].rhs.count;
+        kept.push_back(rule);
+    }
+    reduction.productions = grammar.size() - kept.size();
+    grammar.swap(kept);
+    if (startSymbol != NO_SYMBOL) startSymbol = nonTerminalIds[nonTerminalIndex(startSymbol)];
+    symbols = move(reduced);
+    symbols.buildPerfectHash();
+    firstSet.reset(symbols.nonTerminalCount(), symbols.terminalCount());
+    followSet.reset(symbols.nonTerminalCount(), symbols.terminalCount());
+    return reduction;
+}
+
+// Add FIRST(sequence[from..]) to out, with the epsilon bit if the whole
+// suffix is nullable; true if out grew
+bool LL1Parser::addFirstOf(SymbolSpan sequence, size_t from, uint64_t* out) {
+    bool grew = false;
+    for (size_t i = from; i < sequence.size(); ++i) {
+        SymbolId symbol = sequence[i];
+        if (isTerminal(symbol)) return TerminalSets::setBit(out, symbol) || grew;
+        int n = nonTerminalIndex(symbol);
+        if (firstSet.unionWithoutEpsilon(out, firstSet.row(n))) grew = true;
+        if (!firstSet.hasEpsilon(n)) return grew;
+    }
+    return TerminalSets::setBit(out, firstSet.epsilonBit()) || grew;
+}
+
+// Fill the suffix FIRST cache from the converged FIRST sets, each
+// production from its last symbol back
+void LL1Parser::buildSuffixFirst() {
+    suffixFirst.clear();
+    suffixStart.clear();
+    uint32_t rows = 0;
+    for (const GrammarRule& rule : grammar) {
+        suffixStart.push_back((uint32_t)suffixFirst.size());
+        for (size_t i = 0; i < rule.rhs.size(); ++i) {
+            SymbolId symbol = rule.rhs[i];
+            bool ownRow = !isTerminal(symbol) && firstSet.hasEpsilon(nonTerminalIndex(symbol)) && i + 1 < rule.rhs.size();
+            suffixFirst.push_back(SuffixFirst{ symbol, ownRow ? rows++ : NO_SUFFIX_ROW, false });
+        }
+        suffixFirst.push_back(SuffixFirst{ NO_SYMBOL, NO_SUFFIX_ROW, true });
+    }
+    suffixSets.reset(rows, symbols.terminalCount());
+    for (size_t p = 0; p < grammar.size(); ++p) {
+        SuffixFirst* suffix = &suffixFirst[suffixStart[p]];
+        for (size_t i = grammar[p].rhs.size(); i-- > 0;) {
+            if (isTerminal(suffix[i].symbol)) continue;
+            int n = nonTerminalIndex(suffix[i].symbol);
+            if (suffix[i].row == NO_SUFFIX_ROW) {
+                suffix[i].nullable = firstSet.hasEpsilon(n);
+                continue;
+            }
+            uint64_t* row = suffixSets.row(suffix[i].row);
+            suffixSets.unionWithoutEpsilon(row, firstSet.row(n));
+            unionFirstOf(suffix[i + 1], row);
+            suffix[i].nullable = suffix[i + 1].nullable;
+        }
+    }
+}
+
+// Add the terminals of a cached suffix FIRST set to out; true if it grew
+bool LL1Parser::unionFirstOf(const SuffixFirst& suffix, uint64_t* out) const {
+    if (suffix.row != NO_SUFFIX_ROW) return suffixSets.unionWithoutEpsilon(out, suffixSets.row(suffix.row));
+    if (suffix.symbol == NO_SYMBOL) return false;
+    if (isTerminal(suffix.symbol)) return TerminalSets::setBit(out, suffix.symbol);
+    return firstSet.unionWithoutEpsilon(out, firstSet.row(nonTerminalIndex(suffix.symbol)));
+}
+
+bool LL1Parser::firstContains(const SuffixFirst& suffix, SymbolId terminal) const {
+    if (suffix.row != NO_SUFFIX_ROW) return TerminalSets::testBit(suffixSets.row(suffix.row), terminal);
+    if (suffix.symbol == NO_SYMBOL) return false;
+    if (isTerminal(suffix.symbol)) return suffix.symbol == terminal;
+    return TerminalSets::testBit(firstSet.row(nonTerminalIndex(suffix.symbol)), terminal);
+}
+
+// Call f(terminal) for every terminal of a cached suffix FIRST set
+template <class F>
+void LL1Parser::forEachFirst(const SuffixFirst& suffix, F f) const {
+    if (suffix.row != NO_SUFFIX_ROW) suffixSets.forEachTerminal(suffixSets.row(suffix.row), f);
+    else if (suffix.symbol == NO_SYMBOL) return;
+    else if (isTerminal(suffix.symbol)) f(suffix.symbol);
+    else firstSet.forEachTerminal(firstSet.row(nonTerminalIndex(suffix.symbol)), f);
+}
+
+// Strongly connected components of a graph given as adjacency lists, found
+// with an iterative Tarjan search so deep grammars cannot overflow the call
+// stack. Components come out in reverse topological order: every component
+// follows the components its edges lead to. componentOf maps node -> index.
+vector<vector<int>> stronglyConnectedComponents(const vector<vector<int>>& edges, vector<int>& componentOf) {
+    int count = (int)edges.size();
+    vector<int> order(count, -1), low(count), stack;
+    vector<char> onStack(count, 0);
+    vector<pair<int, size_t>> path;     // DFS frames: node, next edge to follow
+    vector<vector<int>> components;
+    componentOf.assign(count, -1);
+    int nextOrder = 0;
+    for (int root = 0; root < count; ++root) {
+        if (order[root] >= 0) continue;
+        order[root] = low[root] = nextOrder++;
+        stack.push_back(root);
+        onStack[root] = 1;
+        path.push_back({ root, 0 });
+        while (!path.empty()) {
+            int n = path.back().first;
+            if (path.back().second < edges[n].size()) {
+                int m = edges[n][path.back().second++];
+                if (order[m] < 0) {
+                    order[m] = low[m] = nextOrder++;
+                    stack.push_back(m);
+                    onStack[m] = 1;
+                    path.push_back({ m, 0 });
+                }
+                else if (onStack[m]) {
+                    low[n] = min(low[n], order[m]);
+                }
+                continue;
+            }
+            path.pop_back();
+            if (!path.empty()) low[path.back().first] = min(low[path.back().first], low[n]);
+            if (low[n] != order[n]) continue;
+            components.emplace_back();
+            int m;
+            do {
+                m = stack.back();
+                stack.pop_back();
+                onStack[m] = 0;
+                componentOf[m] = (int)components.size() - 1;
+                components.back().push_back(m);
+            } while (m != n);
+        }
+    }
+    return components;
+}
+
+// Left recursion is only searched for in the cycles of the left-corner
+// graph (A -> B when an A production starts with B). In each cycle the
+// members are taken in index order: productions of Ai starting with an
+// earlier member Aj have Aj's productions substituted, and then
+//   Ai -> Ai a | b   becomes   Ai -> b Ai'   Ai' -> a Ai' | epsilon
+// Left-factoring then repeatedly takes the first group of a nonterminal's
+// productions that share a first symbol and moves their longest common
+// prefix a out:
+//   A -> a b | a c   becomes   A -> a A'   A' -> b | c
+// Rewritten nonterminals keep the place of their first production in the
+// grammar, followed by their helpers; other productions are not touched.
+GrammarRewrite LL1Parser::rewriteGrammar() {
+    PhaseTimer timer(stats.rewriteGrammarNs);
+    GrammarRewrite rewrite;
+    int count = symbols.nonTerminalCount();
+    vector<vector<vector<SymbolId>>> alternatives(count);
+    for (const GrammarRule& rule : grammar) alternatives[nonTerminalIndex(rule.lhs)].emplace_back(rule.rhs.begin(), rule.rhs.end());
+    vector<char> changed(count, 0);
+    vector<vector<int>> helpersOf(count);
+    auto addHelper = [&](int n) {
+        string name(symbols.name(nonTerminalId(n)));
+        do name += '\'';
+        while (symbols.find(name) != NO_SYMBOL);
+        int helper = nonTerminalIndex(symbols.addNonTerminal(name));
+        alternatives.emplace_back();
+        changed.push_back(1);
+        helpersOf.emplace_back();
+        helpersOf[n].push_back(helper);
+        rewrite.added.push_back(name);
+        return helper;
+    };
+
+    vector<vector<int>> leftCorners(count);
+    for (int n = 0; n < count; ++n) {
+        for (const vector<SymbolId>& rhs : alternatives[n]) {
+            if (!rhs.empty() && !isTerminal(rhs[0])) leftCorners[n].push_back(nonTerminalIndex(rhs[0]));
+        }
+    }
+    vector<int> componentOf;
+    vector<vector<int>> components = stronglyConnectedComponents(leftCorners, componentOf);
+    for (vector<int>& members : components) {
+        if (members.size() == 1 && find(leftCorners[members[0]].begin(), leftCorners[members[0]].end(), members[0]) == leftCorners[members[0]].end()) continue;
+        sort(members.begin(), members.end());
+        for (size_t i = 0; i < members.size(); ++i) {
+            int n = members[i];
+            SymbolId self = nonTerminalId(n);
+            for (size_t j = 0; j < i; ++j) {
+                SymbolId earlier = nonTerminalId(members[j]);
+                vector<vector<SymbolId>> substituted;
+                for (vector<SymbolId>& rhs : alternatives[n]) {
+                    if (rhs.empty() || rhs[0] != earlier) {
+                        substituted.push_back(move(rhs));
+                        continue;
+                    }
+                    for (const vector<SymbolId>& head : alternatives[members[j]]) {
+                        substituted.push_back(head);
+                        substituted.back().insert(substituted.back().end(), rhs.begin() + 1, rhs.end());
+                    }
+                }
+                alternatives[n].swap(substituted);
+            }
+            // A member that is not left-recursive after the substitutions
+            // keeps its own productions; the substituted ones only feed the
+            // later members
+            vector<vector<SymbolId>> recursive, other;
+            bool selfLoop = false;
+            for (vector<SymbolId>& rhs : alternatives[n]) {
+                if (rhs.empty() || rhs[0] != self) other.push_back(move(rhs));
+                else if (rhs.size() > 1) recursive.emplace_back(rhs.begin() + 1, rhs.end());
+                else selfLoop = true;   // A -> A alone is dropped
+            }
+            if (!recursive.empty() || selfLoop) {
+                changed[n] = 1;
+                rewrite.leftRecursive.emplace_back(symbols.name(self));
+            }
+            if (recursive.empty()) {
+                alternatives[n].swap(other);
+                continue;
+            }
+            int tail = addHelper(n);
+            for (vector<SymbolId>& rhs : other) rhs.push_back(nonTerminalId(tail));
+            for (vector<SymbolId>& rhs : recursive) rhs.push_back(nonTerminalId(tail));
+            recursive.emplace_back();
+            alternatives[n].swap(other);
+            alternatives[tail].swap(recursive);
+        }
+    }
+
+    for (int n = 0; n < (int)alternatives.size(); ++n) {
+        bool factoredAny = false;
+        for (;;) {
+            vector<vector<SymbolId>>& rhsList = alternatives[n];
+            size_t first = 0, group = 0;
+            for (; first < rhsList.size(); ++first) {
+                if (rhsList[first].empty()) continue;
+                group = count_if(rhsList.begin() + first, rhsList.end(), [&](const vector<SymbolId>& rhs) { return !rhs.empty() && rhs[0] == rhsList[first][0]; });
+                if (group > 1) break;
+            }
+            if (first == rhsList.size()) break;
+            SymbolId head = rhsList[first][0];
+            size_t prefix = rhsList[first].size();
+            for (const vector<SymbolId>& rhs : rhsList) {
+                if (rhs.empty() || rhs[0] != head) continue;
+                size_t common = 0;
+                while (common < prefix && common < rhs.size() && rhs[common] == rhsList[first][common]) ++common;
+                prefix = common;
+            }
+            vector<SymbolId> factored(rhsList[first].begin(), rhsList[first].begin() + prefix);
+            vector<vector<SymbolId>> kept, rests;
+            size_t place = 0;
+            for (size_t i = 0; i < rhsList.size(); ++i) {
+                if (rhsList[i].empty() || rhsList[i][0] != head) kept.push_back(move(rhsList[i]));
+                else {
+                    rests.emplace_back(rhsList[i].begin() + prefix, rhsList[i].end());
+                    if (i == first) {
+                        place = kept.size();
+                        kept.emplace_back();
+                    }
+                }
+            }
+            if (!factoredAny) rewrite.leftFactored.emplace_back(symbols.name(nonTerminalId(n)));
+            factoredAny = true;
+            changed[n] = 1;
+            int helper = addHelper(n);
+            factored.push_back(nonTerminalId(helper));
+            kept[place].swap(factored);
+            alternatives[n].swap(kept);
+            alternatives[helper].swap(rests);
+        }
+    }
+
+    if (rewrite.leftRecursive.empty() && rewrite.leftFactored.empty()) return rewrite;
+    vector<GrammarRule> rewritten;
+    vector<char> emitted(alternatives.size(), 0);
+    function<void(int)> emit = [&](int n) {
+        emitted[n] = 1;
+        for (const vector<SymbolId>& rhs : alternatives[n]) {
+            SymbolId* stored = rhsArena.allocateArray<SymbolId>(rhs.size());
+            copy(rhs.begin(), rhs.end(), stored);
+            GrammarRule rule;
+            rule.lhs = nonTerminalId(n);
+            rule.rhs.first = stored;
+            rule.rhs.count = (uint32_t)rhs.size();
+            rewritten.push_back(rule);
+        }
+        for (int helper : helpersOf[n]) emit(helper);
+    };
+    for (const GrammarRule& rule : grammar) {
+        int n = nonTerminalIndex(rule.lhs);
+        if (!changed[n]) rewritten.push_back(rule);
+        else if (!emitted[n]) emit(n);
+    }
+    grammar.swap(rewritten);
+    symbols.buildPerfectHash();
+    firstSet.reset(symbols.nonTerminalCount(), symbols.terminalCount());
+    followSet.reset(symbols.nonTerminalCount(), symbols.terminalCount());
+    return rewrite;
+}
+
+// Call solve(component, worker) for every component from
+// stronglyConnectedComponents(dependsOn), where dependsOn[n] lists the nodes
+// whose results n reads. A component starts only after all components it
+// depends on are finished; independent ones run concurrently on up to
+// `threads` workers, numbered 0..threads-1.
+void solveInDependencyOrder(const vector<vector<int>>& components, const vector<int>& componentOf,
+    const vector<vector<int>>& dependsOn, int threads, const function<void(int, int)>& solve) {
+    int count = (int)components.size();
+    threads = min(threads, count);
+    if (threads <= 1) {
+        for (int c = 0; c < count; ++c) solve(c, 0);
+        return;
+    }
+
+    vector<vector<int>> dependents(count);
+    vector<int> pending(count, 0), lastSeen(count, -1), ready;
+    for (int c = 0; c < count; ++c) {
+        for (int n : components[c]) {
+            for (int m : dependsOn[n]) {
+                int d = componentOf[m];
+                if (d == c || lastSeen[d] == c) continue;
+                lastSeen[d] = c;
+                dependents[d].push_back(c);
+                ++pending[c];
+            }
+        }
+        if (pending[c] == 0) ready.push_back(c);
+    }
+
+    mutex lock;
+    condition_variable wake;
+    int finished = 0;
+    auto worker = [&](int id) {
+        unique_lock<mutex> guard(lock);
+        for (;;) {
+            wake.wait(guard, [&]() { return !ready.empty() || finished == count; });
+            if (ready.empty()) return;
+            int c = ready.back();
+            ready.pop_back();
+            guard.unlock();
+            solve(c, id);
+            guard.lock();
+            ++finished;
+            for (int d : dependents[c]) {
+                if (--pending[d] == 0) {
+                    ready.push_back(d);
+                    wake.notify_one();
+                }
+            }
+            if (finished == count) wake.notify_all();
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (thread& t : pool) t.join();
+}
+
+// Below this many nonterminals the analysis is faster on one thread
+const int PARALLEL_ANALYSIS_MIN_NONTERMINALS = 512;
+
+int LL1Parser::analysisWorkers() const {
+    if (analysisThreads > 0) return analysisThreads;
+    if (symbols.nonTerminalCount() < PARALLEL_ANALYSIS_MIN_NONTERMINALS) return 1;
+    return (int)max(1u, thread::hardware_concurrency());
+}
+
+// Compute the FIRST sets for all non-terminals. FIRST(A) reads FIRST(B) for
+// every B on A's right-hand sides, so the nonterminals are split into the
+// strongly connected components of that graph and solved callees first.
+// Inside a component a worklist holds the nonterminals to re-evaluate; when
+// FIRST(B) grows, only the members with B on some RHS are queued again.
+// Components outside each other's reach are solved in parallel.
+void LL1Parser::computeFirst() {
+    PhaseTimer timer(stats.computeFirstNs);
+    int count = symbols.nonTerminalCount();
+    vector<vector<int>> productionsOf(count), users(count), uses(count);
+    for (size_t i = 0; i < grammar.size(); ++i) {
+        int lhs = nonTerminalIndex(grammar[i].lhs);
+        productionsOf[lhs].push_back((int)i);
+        for (SymbolId symbol : grammar[i].rhs) {
+            if (isTerminal(symbol)) continue;
+            users[nonTerminalIndex(symbol)].push_back(lhs);
+            uses[lhs].push_back(nonTerminalIndex(symbol));
+        }
+    }
+
+    vector<int> componentOf;
+    vector<vector<int>> components = stronglyConnectedComponents(uses, componentOf);
+    int workers = analysisWorkers();
+    vector<uint64_t> iterations(workers, 0);
+    vector<char> queued(count, 0);  // each entry is only touched by its component's solver
+    solveInDependencyOrder(components, componentOf, uses, workers, [&](int c, int worker) {
+        vector<int> worklist(components[c].rbegin(), components[c].rend());
+        for (int n : worklist) queued[n] = 1;
+        while (!worklist.empty()) {
+            int n = worklist.back();
+            worklist.pop_back();
+            queued[n] = 0;
+            ++iterations[worker];
+            bool grew = false;
+            for (int p : productionsOf[n]) {
+                if (addFirstOf(grammar[p].rhs, 0, firstSet.row(n))) grew = true;
+            }
+            if (!grew) continue;
+            for (int user : users[n]) {
+                if (componentOf[user] == c && !queued[user]) {
+                    queued[user] = 1;
+                    worklist.push_back(user);
+                }
+            }
+        }
+    });
+    for (uint64_t n : iterations) stats.firstIterations += n;
+    buildSuffixFirst();
+}
+
+// Compute the FOLLOW sets for all non-terminals. Each nonterminal B of a
+// production takes FIRST of the suffix after it from the suffix cache; a
+// nullable suffix makes FOLLOW(lhs) a source of FOLLOW(B).
+// Every member of a strongly connected component of that source graph ends
+// with the same set, so each component is solved in one step as the union
+// of its members and of the already finished components feeding it.
+void LL1Parser::computeFollow() {
+    PhaseTimer timer(stats.computeFollowNs);
+    int count = symbols.nonTerminalCount();
+    if (startSymbol != NO_SYMBOL) TerminalSets::setBit(followSet.row(nonTerminalIndex(startSymbol)), END_MARKER);
+
+    vector<vector<int>> sources(count);
+    for (size_t p = 0; p < grammar.size(); ++p) {
+        const GrammarRule& rule = grammar[p];
+        int lhs = nonTerminalIndex(rule.lhs);
+        for (size_t i = 0; i < rule.rhs.size(); ++i) {
+            if (isTerminal(rule.rhs[i])) continue;
+            int n = nonTerminalIndex(rule.rhs[i]);
+            const SuffixFirst& rest = firstOfSuffix(p, i + 1);
+            unionFirstOf(rest, followSet.row(n));
+            if (rest.nullable && n != lhs) sources[n].push_back(lhs);
+        }
+    }
+
+    vector<int> componentOf;
+    vector<vector<int>> components = stronglyConnectedComponents(sources, componentOf);
+    int workers = analysisWorkers();
+    vector<uint64_t> iterations(workers, 0);
+    solveInDependencyOrder(components, componentOf, sources, workers, [&](int c, int worker) {
+        const vector<int>& members = components[c];
+        uint64_t* merged = followSet.row(members[0]);
+        for (int n : members) {
+            followSet.unionWithoutEpsilon(merged, followSet.row(n));
+            for (int source : sources[n]) followSet.unionWithoutEpsilon(merged, followSet.row(source));
+        }
+        for (size_t i = 1; i < members.size(); ++i) copy(merged, merged + followSet.wordCount(), followSet.row(members[i]));
+        iterations[worker] += members.size();
+    });
+    for (uint64_t n : iterations) stats.followIterations += n;
+}
+
+// Build the parse table using FIRST and FOLLOW sets
+void LL1Parser::buildParseTable() {
+    PhaseTimer timer(stats.buildParseTableNs);
+    if (grammar.size() >= NO_PRODUCTION) throw length_error("grammar has too many productions for a 16-bit parse table");
+    parseTable.reset(symbols.nonTerminalCount(), symbols.terminalCount());
+    conflicts.clear();
+    for (size_t i = 0; i < grammar.size(); ++i) addTableEntries(i);
+    buildPushSequences();
+    if (strict && !conflicts.empty()) {
+        throw runtime_error("grammar is not LL(1): " + to_string(conflicts.size()) + (conflicts.size() == 1 ? " table conflict" : " table conflicts"));
+    }
+}
+
+// Enter one production in its LHS row: under FIRST(rhs), and under
+// FOLLOW(lhs) when rhs is nullable. Later productions overwrite earlier
+// ones; every overwrite of another production is recorded as a conflict.
+void LL1Parser::addTableEntries(size_t production) {
+    const GrammarRule& rule = grammar[production];
+    const SuffixFirst& first = firstOfSuffix(production, 0);
+    auto enter = [&](SymbolId terminal, bool byFollow) {
+        ProductionIndex& cell = parseTable.at(rule.lhs, terminal);
+        if (cell != NO_PRODUCTION && cell != production) recordConflict(terminal, (ProductionIndex)production, byFollow, cell);
+        cell = (ProductionIndex)production;
+    };
+    forEachFirst(first, [&](SymbolId terminal) { enter(terminal, false); });
+    if (first.nullable) {
+        followSet.forEachTerminal(followSet.row(nonTerminalIndex(rule.lhs)), [&](SymbolId terminal) { enter(terminal, true); });
+    }
+}
+
+// Note that kept takes a cell from replaced. Whether replaced got there
+// through FOLLOW is only worked out here, off the conflict-free path.
+void LL1Parser::recordConflict(SymbolId terminal, ProductionIndex kept, bool keptByFollow, ProductionIndex replaced) {
+    conflicts.push_back(TableConflict{ grammar[kept].lhs, terminal, kept, replaced, keptByFollow,
+        !firstContains(firstOfSuffix(replaced, 0), terminal) });
+}
+
+// Production as written in a grammar file, e.g. "E' -> + T E'"
+string LL1Parser::productionText(ProductionIndex production) const {
+    const GrammarRule& rule = grammar[production];
+    string text(symbols.name(rule.lhs));
+    text += " ->";
+    for (SymbolId symbol : rule.rhs) (text += ' ') += symbols.name(symbol);
+    if (rule.rhs.empty()) text += " epsilon";
+    return text;
+}
+
+// One line per conflict, naming its kind, the cell and both productions
+void LL1Parser::writeConflicts(ostream& out) const {
+    for (const TableConflict& conflict : conflicts) {
+        const char* kind = conflict.keptByFollow == conflict.replacedByFollow ? (conflict.keptByFollow ? "FOLLOW/FOLLOW" : "FIRST/FIRST") : "FIRST/FOLLOW";
+        out << "LL(1) " << kind << " conflict at [" << symbols.name(conflict.nonTerminal) << ", " << symbols.name(conflict.terminal)
+            << "]: " << productionText(conflict.replaced) << " and " << productionText(conflict.kept)
+            << ", using " << productionText(conflict.kept) << '\n';
+    }
+}
+
+size_t LL1Parser::memoryUsage() const {
+    size_t bytes = sizeof(*this) + grammar.size() * sizeof(GrammarRule) + pushStart.size() * sizeof(uint32_t);
+    for (const GrammarRule& rule : grammar) bytes += 2 * rule.rhs.count * sizeof(SymbolId);    // RHS and push order
+    for (int t = 0; t < symbols.terminalCount(); ++t) bytes += symbols.name(t).size() + 48;    // text, view and index entry
+    for (int n = 0; n < symbols.nonTerminalCount(); ++n) bytes += symbols.name(nonTerminalId(n)).size() + 48;
+    bytes += (firstSet.rawSize() + followSet.rawSize() + suffixSets.rawSize()) * sizeof(uint64_t);
+    bytes += suffixFirst.size() * sizeof(SuffixFirst) + suffixStart.size() * sizeof(uint32_t);
+    bytes += (size_t)parseTable.rows * parseTable.columns * sizeof(ProductionIndex);
+    return bytes + conflicts.size() * sizeof(TableConflict);
+}
+
+// The bytes of a name as the body of a C++ string literal
+static string cppString(string_view text) {
+    string literal;
+    for (char c : text) {
+        unsigned char byte = (unsigned char)c;
+        if (c == '"' || c == '\\') (literal += '\\') += c;
+        else if (byte >= 0x20 && byte < 0x7F) literal += c;
+        else {
+            char escape[5];
+            snprintf(escape, sizeof(escape), "\\%03o", byte);
+            literal += escape;
+        }
+    }
+    return literal;
+}
+
+// The generated code mirrors ParseSession: match() and unexpected() are its
+// two error reports, and parse() checks for tokens after the start symbol
+// the way a leftover "$" does. A production that ends in its own
+// nonterminal loops instead of recursing, so E' -> + T E' style tails take
+// constant stack; other last calls are written as tail calls.
+void LL1Parser::writeRecursiveDescent(ostream& out, const string& name) const {
+    int terminalCount = symbols.terminalCount();
+    int nonTerminalCount = symbols.nonTerminalCount();
+    vector<pair<string_view, SymbolId>> names;
+    for (SymbolId t = 1; t < terminalCount; ++t) names.push_back({ symbols.name(t), t });
+    for (int n = 0; n < nonTerminalCount; ++n) names.push_back({ symbols.name(nonTerminalId(n)), nonTerminalId(n) });
+    sort(names.begin(), names.end());
+
+    out << "// Recursive-descent parser generated by Demo_02 --emit-parser. Do not edit;\n"
+        "// regenerate it from the grammar instead.\n"
+        "#include <algorithm>\n#include <cstddef>\n#include <fstream>\n#include <iostream>\n#include <iterator>\n"
+        "#include <ostream>\n#include <string>\n#include <string_view>\n#include <utility>\n#include <vector>\n\n"
+        "namespace " << name << " {\n\n"
+        "const int NO_SYMBOL = 0x7FFFFFFF;\n\n"
+        "// A token with the symbol ID of its type name from symbolId()\n"
+        "struct Token {\n    int line;\n    int type;\n    std::string_view value;\n};\n\n"
+        "// Terminals are 1.., nonterminals -1.. (as in the grammar they came\n"
+        "// from); NO_SYMBOL for other names and for \"$\"\n"
+        "inline int symbolId(std::string_view name) {\n";
+    if (names.empty()) {
+        out << "    (void)name;\n    return NO_SYMBOL;\n}\n\n";
+    }
+    else {
+        out << "    static const std::pair<std::string_view, int> sorted[] = {\n";
+        for (const auto& entry : names) out << "        { \"" << cppString(entry.first) << "\", " << entry.second << " },\n";
+        out << "    };\n"
+            "    auto it = std::lower_bound(std::begin(sorted), std::end(sorted), name,\n"
+            "        [](const std::pair<std::string_view, int>& entry, std::string_view key) { return entry.first < key; });\n"
+            "    return it != std::end(sorted) && it->first == name ? it->second : NO_SYMBOL;\n}\n\n";
+    }
+
+    out << "class Parser {\npublic:\n"
+        "    Parser(const Token* tokens, size_t count, std::ostream& errors) : tokens(tokens), count(count), errors(errors) {}\n\n"
+        "    // True if the tokens form a sentence; otherwise the first syntax\n"
+        "    // error has been written to errors\n"
+        "    bool parse() {\n";
+    if (startSymbol != NO_SYMBOL) out << "        if (!nonTerminal" << nonTerminalIndex(startSymbol) << "()) return false;\n";
+    out << "        return pos == count || unexpected();\n    }\n\n"
+        "private:\n"
+        "    static constexpr const char* terminalNames[" << terminalCount << "] = {";
+    for (SymbolId t = 0; t < terminalCount; ++t) out << (t % 8 ? " " : "\n        ") << '"' << cppString(symbols.name(t)) << "\",";
+    out << "\n    };\n\n"
+        "    const Token* tokens;\n    size_t count;\n    size_t pos = 0;\n    std::ostream& errors;\n\n"
+        "    int lookahead() const { return pos < count ? tokens[pos].type : 0; }\n\n"
+        "    bool match(int terminal) {\n"
+        "        if (pos < count && tokens[pos].type == terminal) {\n            ++pos;\n            return true;\n        }\n"
+        "        if (pos == count) errors << \"Syntax error at line -1: expected '\" << terminalNames[terminal] << \"' but found '$'\\n\";\n"
+        "        else errors << \"Syntax error at line \" << tokens[pos].line << \": expected '\" << terminalNames[terminal] << \"' but found '\" << tokens[pos].value << \"'\\n\";\n"
+        "        return false;\n    }\n\n"
+        "    // At the end of input the last token is reported\n"
+        "    bool unexpected() {\n"
+        "        const Token* token = pos < count ? &tokens[pos] : count ? &tokens[count - 1] : nullptr;\n"
+        "        if (token) errors << \"Syntax error at line \" << token->line << \": unexpected token '\" << token->value << \"'\\n\";\n"
+        "        else errors << \"Syntax error at line -1: unexpected token '$'\\n\";\n"
+        "        return false;\n    }\n";
+
+    // Terminals selecting each production, in table order
+    vector<vector<SymbolId>> selectors(grammar.size());
+    for (int n = 0; n < nonTerminalCount; ++n) {
+        for (SymbolId t = 0; t < terminalCount; ++t) {
+            ProductionIndex production = parseTable.lookup(nonTerminalId(n), t);
+            if (production != NO_PRODUCTION) selectors[production].push_back(t);
+        }
+    }
+    for (int n = 0; n < nonTerminalCount; ++n) {
+        SymbolId self = nonTerminalId(n);
+        vector<size_t> productions;
+        bool loops = false;
+        for (size_t p = 0; p < grammar.size(); ++p) {
+            if (grammar[p].lhs != self || selectors[p].empty()) continue;
+            productions.push_back(p);
+            loops |= !grammar[p].rhs.empty() && grammar[p].rhs[grammar[p].rhs.size() - 1] == self;
+        }
+        string indent = loops ? "            " : "        ";
+        out << "\n    bool nonTerminal" << n << "() {\n";
+        if (loops) out << "        for (;;) {\n";
+        out << indent << "switch (lookahead()) {\n";
+        // A token named after the nonterminal matches it, as on the stack
+        out << indent << "case " << self << ":     // '" << symbols.name(self) << "' as a token\n" << indent << "    ++pos;\n" << indent << "    return true;\n";
+        for (size_t p : productions) {
+            SymbolSpan rhs = grammar[p].rhs;
+            // Production comments end in its number, so a name ending in a
+            // backslash can not splice the next line
+            out << indent << "// " << productionText((ProductionIndex)p) << "  (" << p << ")\n";
+            for (SymbolId t : selectors[p]) out << indent << "case " << t << ":     // '" << symbols.name(t) << "'\n";
+            for (uint32_t i = 0; i < rhs.size(); ++i) {
+                SymbolId symbol = rhs[i];
+                bool last = i + 1 == rhs.size();
+                out << indent << "    ";
+                // The selecting terminal of a production starting with one
+                // is the lookahead itself
+                if (i == 0 && isTerminal(symbol)) out << "++pos;\n";
+                else if (isTerminal(symbol)) out << (last ? "return match(" : "if (!match(") << symbol << (last ? ");\n" : ")) return false;\n");
+                else if (last && symbol == self) out << "continue;\n";
+                else out << (last ? "return nonTerminal" : "if (!nonTerminal") << nonTerminalIndex(symbol) << (last ? "();\n" : "()) return false;\n");
+            }
+            if (rhs.empty() || (rhs.size() == 1 && isTerminal(rhs[0]))) out << indent << "    return true;\n";
+        }
+        out << indent << "default:\n" << indent << "    return unexpected();\n" << indent << "}\n";
+        if (loops) out << "        }\n";
+        out << "    }\n";
+    }
+    out << "};\n\n"
+        "// Parse tokens whose types come from symbolId()\n"
+        "inline bool parse(const Token* tokens, size_t count, std::ostream& errors) {\n"
+        "    return Parser(tokens, count, errors).parse();\n}\n\n"
+        "} // namespace " << name << "\n\n"
+        "#ifndef LL1_PARSER_NO_MAIN\n"
+        "// Reads a \"line type value\" token file like Demo_02 and prints YES or NO\n"
+        "int main(int argc, char* argv[]) {\n"
+        "    if (argc < 3) {\n        std::cerr << \"usage: \" << argv[0] << \" tokens.txt errors.txt\\n\";\n        return 1;\n    }\n"
+        "    std::ifstream in(argv[1], std::ios::binary);\n"
+        "    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());\n"
+        "    std::vector<" << name << "::Token> tokens;\n"
+        "    auto isSpace = [](char c) { return c == ' ' || c == '\\t' || c == '\\r' || c == '\\v' || c == '\\f'; };\n"
+        "    size_t p = 0;\n"
+        "    auto field = [&](size_t lineEnd) {\n"
+        "        while (p < lineEnd && isSpace(text[p])) ++p;\n"
+        "        size_t start = p;\n"
+        "        while (p < lineEnd && !isSpace(text[p])) ++p;\n"
+        "        return std::string_view(text.data() + start, p - start);\n"
+        "    };\n"
+        "    while (p < text.size()) {\n"
+        "        size_t lineEnd = text.find('\\n', p);\n"
+        "        if (lineEnd == std::string::npos) lineEnd = text.size();\n"
+        "        std::string_view number = field(lineEnd);\n"
+        "        std::string_view type = field(lineEnd);\n"
+        "        if (!type.empty()) {\n"
+        "            int line = 0;\n"
+        "            bool negative = !number.empty() && number[0] == '-';\n"
+        "            for (size_t i = negative ? 1 : 0; i < number.size() && number[i] >= '0' && number[i] <= '9'; ++i) line = line * 10 + (number[i] - '0');\n"
+        "            tokens.push_back({ negative ? -line : line, " << name << "::symbolId(type), field(lineEnd) });\n"
+        "        }\n"
+        "        p = lineEnd + 1;\n"
+        "    }\n"
+        "    std::ofstream errors(argv[2]);\n"
+        "    bool accepted = " << name << "::parse(tokens.data(), tokens.size(), errors);\n"
+        "    std::cout << (accepted ? \"YES\" : \"NO\") << '\\n';\n"
+        "    return 0;\n}\n"
+        "#endif\n";
+}
+
+// Lay out every RHS reversed, so an expansion is one bulk copy onto the stack
+void LL1Parser::buildPushSequences() {
+    pushSymbols.clear();
+    pushStart.assign(1, 0);
+    for (const GrammarRule& rule : grammar) {
+        pushSymbols.insert(pushSymbols.end(), rule.rhs.rbegin(), rule.rhs.rend());
+        pushStart.push_back((uint32_t)pushSymbols.size());
+    }
+}
+
+// Resolve a RHS name given to addProduction/removeProduction. With intern
+// false, unknown names give NO_SYMBOL instead of being added.
+static SymbolId resolveEditSymbol(SymbolTable& symbols, const string& name, bool intern) {
+    string_view text = name;
+    bool quoted = text.size() >= 2 && text.front() == '\'' && text.back() == '\'';
+    if (quoted) text = text.substr(1, text.size() - 2);
+    SymbolId id = symbols.find(text);
+    if (quoted && id != NO_SYMBOL && !isTerminalId(id)) return NO_SYMBOL;
+    if (id != NO_SYMBOL || !intern) return id;
+    if (!quoted && isupper((unsigned char)text[0])) return symbols.addNonTerminal(text);
+    return symbols.addTerminal(text);
+}
+
+bool LL1Parser::addProduction(const string& lhs, const vector<string>& rhs) {
+    if (lhs.empty() || grammar.size() + 1 >= NO_PRODUCTION) return false;
+    SymbolId head = symbols.find(lhs);
+    if (head != NO_SYMBOL && isTerminal(head)) return false;
+    if (head == NO_SYMBOL) head = symbols.addNonTerminal(lhs);
+    vector<SymbolId> body;
+    for (const string& name : rhs) {
+        if (name.empty() || name == "epsilon") continue;
+        body.push_back(name == lhs ? head : resolveEditSymbol(symbols, name, true));
+        if (body.back() == NO_SYMBOL) return false;
+    }
+    if (symbols.nonTerminalCount() != parseTable.rows || symbols.terminalCount() != parseTable.columns) {
+        symbols.buildPerfectHash();
+        firstSet.resize(symbols.nonTerminalCount(), symbols.terminalCount());
+        followSet.resize(symbols.nonTerminalCount(), symbols.terminalCount());
+        parseTable.resize(symbols.nonTerminalCount(), symbols.terminalCount());
+    }
+
+    GrammarRule rule;
+    rule.lhs = head;
+    SymbolId* stored = rhsArena.allocateArray<SymbolId>(body.size());
+    copy(body.begin(), body.end(), stored);
+    rule.rhs.first = stored;
+    rule.rhs.count = (uint32_t)body.size();
+    grammar.push_back(rule);
+    if (startSymbol == NO_SYMBOL) {
+        startSymbol = head;
+        TerminalSets::setBit(followSet.row(nonTerminalIndex(head)), END_MARKER);
+    }
+    if (pushStart.size() == grammar.size()) {
+        pushSymbols.insert(pushSymbols.end(), rule.rhs.rbegin(), rule.rhs.rend());
+        pushStart.push_back((uint32_t)pushSymbols.size());
+    }
+    else {
+        buildPushSequences();
+    }
+    updateAfterEdit(rule, true);
+    return true;
+}
+
+bool LL1Parser::removeProduction(const string& lhs, const vector<string>& rhs) {
+    SymbolId head = symbols.find(lhs);
+    if (head == NO_SYMBOL || isTerminal(head)) return false;
+    vector<SymbolId> body;
+    for (const string& name : rhs) {
+        if (name.empty() || name == "epsilon") continue;
+        body.push_back(resolveEditSymbol(symbols, name, false));
+        if (body.back() == NO_SYMBOL) return false;
+    }
+    size_t p = grammar.size();
+    for (size_t i = grammar.size(); i-- > 0;) {
+        if (grammar[i].lhs == head && equal(body.begin(), body.end(), grammar[i].rhs.begin(), grammar[i].rhs.end())) {
+            p = i;
+            break;
+        }
+    }
+    if (p == grammar.size()) return false;
+
+    // Later productions move down one index; the edited row is rebuilt
+    GrammarRule rule = grammar[p];
+    grammar.erase(grammar.begin() + p);
+    if (parseTable.cells != parseTable.storage.data()) parseTable.resize(parseTable.rows, parseTable.columns);
+    for (ProductionIndex& cell : parseTable.storage) {
+        if (cell != NO_PRODUCTION && cell > p) --cell;
+    }
+    for (TableConflict& conflict : conflicts) {
+        if (conflict.kept > p) --conflict.kept;
+        if (conflict.replaced > p) --conflict.replaced;
+    }
+    buildPushSequences();
+    updateAfterEdit(rule, false);
+    return true;
+}
+
+// Bring FIRST, FOLLOW and the table up to date after one production was
+// added or removed. An addition can only grow sets, so the worklists start
+// from the edited production and follow whatever grows. A removal can
+// shrink them: FIRST is cleared for the edited LHS and every nonterminal
+// using it, FOLLOW for the nonterminals of the productions whose suffix
+// FIRST sets changed and everything their FOLLOW flows into, and those rows
+// are solved again from empty. Table rows are rebuilt when their FIRST or
+// FOLLOW inputs changed.
+void LL1Parser::updateAfterEdit(const GrammarRule& edited, bool added) {
+    int count = symbols.nonTerminalCount();
+    int words = firstSet.wordCount();
+    productionsOf.resize(count);
+    occurrences.resize(count);
+    for (int n = 0; n < count; ++n) {
+        productionsOf[n].clear();
+        occurrences[n].clear();
+    }
+    for (size_t i = 0; i < grammar.size(); ++i) {
+        productionsOf[nonTerminalIndex(grammar[i].lhs)].push_back((int)i);
+        for (SymbolId symbol : grammar[i].rhs) {
+            if (!isTerminal(symbol)) occurrences[nonTerminalIndex(symbol)].push_back((int)i);
+        }
+    }
+    vector<char> marked(count, 0);
+    auto mark = [&](vector<int>& rows, int n) {
+        if (marked[n]) return;
+        marked[n] = 1;
+        rows.push_back(n);
+    };
+    // Save the given rows, then clear them for a removal; afterwards the
+    // rows that differ from the saved copy are the ones that changed
+    vector<uint64_t> saved;
+    auto saveAndClear = [&](TerminalSets& sets, const vector<int>& rows) {
+        saved.clear();
+        for (int n : rows) {
+            saved.insert(saved.end(), sets.row(n), sets.row(n) + words);
+            sets.clearRow(n);
+        }
+    };
+    auto changedRows = [&](TerminalSets& sets, const vector<int>& rows) {
+        vector<int> changed;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (!equal(saved.begin() + i * words, saved.begin() + (i + 1) * words, sets.row(rows[i]))) changed.push_back(rows[i]);
+        }
+        return changed;
+    };
+
+    // FIRST
+    int editedLhs = nonTerminalIndex(edited.lhs);
+    vector<int> firstRows, grown;
+    mark(firstRows, editedLhs);
+    if (!added) {
+        for (size_t i = 0; i < firstRows.size(); ++i) {
+            for (int p : occurrences[firstRows[i]]) mark(firstRows, nonTerminalIndex(grammar[p].lhs));
+        }
+        saveAndClear(firstSet, firstRows);
+    }
+    vector<int> worklist(firstRows.rbegin(), firstRows.rend());
+    vector<char> queued(count, 0);
+    for (int n : worklist) queued[n] = 1;
+    fill(marked.begin(), marked.end(), 0);
+    while (!worklist.empty()) {
+        int n = worklist.back();
+        worklist.pop_back();
+        queued[n] = 0;
+        ++stats.firstIterations;
+        bool grew = false;
+        for (int p : productionsOf[n]) {
+            if (addFirstOf(grammar[p].rhs, 0, firstSet.row(n))) grew = true;
+        }
+        if (!grew) continue;
+        mark(grown, n);
+        for (int p : occurrences[n]) {
+            int user = nonTerminalIndex(grammar[p].lhs);
+            if (!queued[user]) {
+                queued[user] = 1;
+                worklist.push_back(user);
+            }
+        }
+    }
+    vector<int> firstChanged = added ? grown : changedRows(firstSet, firstRows);
+    buildSuffixFirst();
+
+    // FOLLOW. The productions to rescan are those whose trailers may have
+    // changed; for a removal, also every production mentioning a cleared row.
+    fill(marked.begin(), marked.end(), 0);
+    vector<int> followRows, scan;
+    vector<char> scanned(grammar.size(), 0);
+    auto addScan = [&](int p) {
+        if (scanned[p]) return;
+        scanned[p] = 1;
+        scan.push_back(p);
+    };
+    if (added) addScan((int)grammar.size() - 1);
+    for (int n : firstChanged) {
+        for (int p : occurrences[n]) addScan(p);
+    }
+    if (!added) {
+        for (SymbolId symbol : edited.rhs) {
+            if (!isTerminal(symbol)) mark(followRows, nonTerminalIndex(symbol));
+        }
+        for (int p : scan) {
+            for (SymbolId symbol : grammar[p].rhs) {
+                if (!isTerminal(symbol)) mark(followRows, nonTerminalIndex(symbol));
+            }
+        }
+        // Close over FOLLOW(lhs) -> FOLLOW(B) for B ending a nullable suffix
+        for (size_t i = 0; i < followRows.size(); ++i) {
+            for (int p : productionsOf[followRows[i]]) {
+                SymbolSpan rhs = grammar[p].rhs;
+                for (size_t k = rhs.size(); k-- > 0 && !isTerminal(rhs[k]);) {
+                    mark(followRows, nonTerminalIndex(rhs[k]));
+                    if (!firstSet.hasEpsilon(nonTerminalIndex(rhs[k]))) break;
+                }
+            }
+        }
+        saveAndClear(followSet, followRows);
+        if (startSymbol != NO_SYMBOL) TerminalSets::setBit(followSet.row(nonTerminalIndex(startSymbol)), END_MARKER);
+        for (int n : followRows) {
+            for (int p : occurrences[n]) addScan(p);
+        }
+    }
+
+    // Same suffix FIRST reads as computeFollow. The LHS of every scanned
+    // production and every row that grew seed the propagation worklist.
+    fill(queued.begin(), queued.end(), 0);
+    worklist.clear();
+    auto enqueue = [&](int n) {
+        if (queued[n]) return;
+        queued[n] = 1;
+        worklist.push_back(n);
+    };
+    fill(marked.begin(), marked.end(), 0);
+    grown.clear();
+    for (int p : scan) {
+        const GrammarRule& rule = grammar[p];
+        enqueue(nonTerminalIndex(rule.lhs));
+        for (size_t i = 0; i < rule.rhs.size(); ++i) {
+            if (isTerminal(rule.rhs[i])) continue;
+            int n = nonTerminalIndex(rule.rhs[i]);
+            if (unionFirstOf(firstOfSuffix(p, i + 1), followSet.row(n))) {
+                mark(grown, n);
+                enqueue(n);
+            }
+        }
+    }
+    while (!worklist.empty()) {
+        int n = worklist.back();
+        worklist.pop_back();
+        queued[n] = 0;
+        ++stats.followIterations;
+        for (int p : productionsOf[n]) {
+            SymbolSpan rhs = grammar[p].rhs;
+            for (size_t k = rhs.size(); k-- > 0 && !isTerminal(rhs[k]);) {
+                int target = nonTerminalIndex(rhs[k]);
+                if (target != n && followSet.unionWithoutEpsilon(followSet.row(target), followSet.row(n))) {
+                    mark(grown, target);
+                    enqueue(target);
+                }
+                if (!firstSet.hasEpsilon(target)) break;
+            }
+        }
+    }
+    vector<int> followChanged = added ? grown : changedRows(followSet, followRows);
+
+    // Table rows of the edited LHS, of changed FOLLOW sets and of every
+    // nonterminal with a changed FIRST set on one of its right-hand sides
+    fill(marked.begin(), marked.end(), 0);
+    vector<int> tableRows;
+    mark(tableRows, editedLhs);
+    for (int n : followChanged) mark(tableRows, n);
+    for (int n : firstChanged) {
+        mark(tableRows, n);
+        for (int p : occurrences[n]) mark(tableRows, nonTerminalIndex(grammar[p].lhs));
+    }
+    if (parseTable.cells != parseTable.storage.data()) parseTable.resize(parseTable.rows, parseTable.columns);
+    conflicts.erase(remove_if(conflicts.begin(), conflicts.end(), [&](const TableConflict& conflict) {
+        return marked[nonTerminalIndex(conflict.nonTerminal)] != 0;
+    }), conflicts.end());
+    for (int n : tableRows) {
+        auto row = parseTable.storage.begin() + (size_t)n * parseTable.columns;
+        fill(row, row + parseTable.columns, NO_PRODUCTION);
+        for (int p : productionsOf[n]) addTableEntries(p);
+    }
+}
+
+// Table files start with this header, followed by 8-byte aligned sections:
+// symbol names, rule LHS, RHS offsets, RHS symbols, FIRST and FOLLOW bits,
+// the parse table, which loadTables uses in place, and the conflicts found
+// while building it as four words each: nonterminal, terminal,
+// kept | replaced << 16, and keptByFollow | replacedByFollow << 1.
+struct TableFileHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t terminalCount, nonTerminalCount, productionCount;
+    int32_t startSymbol, setWords;
+    uint64_t grammarHash;
+    uint64_t namesSize, rhsCount;
+    uint64_t conflictCount;
+};
+
+const char TABLE_FILE_MAGIC[8] = { 'L', 'L', '1', 'T', 'A', 'B', 'L', 'E' };
+const uint32_t TABLE_FILE_VERSION = 2;
+
+// FNV-1a hash of a file's contents, 0 if it cannot be read
+uint64_t hashBytes(string_view bytes) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : bytes) {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hashFile(const string& filename) {
+    MappedFile file;
+    if (!file.open(filename)) return 0;
+    return hashBytes(string_view(file.data(), file.size()));
+}
+
+// Write the symbol table, productions, FIRST/FOLLOW and parse table so a
+// later run can skip analysis of an unchanged grammar
+bool LL1Parser::saveTables(const string& filename, uint64_t grammarHash) const {
+    string names;
+    for (int t = 0; t < symbols.terminalCount(); ++t) names.append(symbols.name(t)) += '\0';
+    for (int n = 0; n < symbols.nonTerminalCount(); ++n) names.append(symbols.name(nonTerminalId(n))) += '\0';
+    vector<int32_t> lhs;
+    vector<uint32_t> rhsOffsets(1, 0);
+    vector<int32_t> rhs;
+    for (const GrammarRule& rule : grammar) {
+        lhs.push_back(rule.lhs);
+        rhs.insert(rhs.end(), rule.rhs.begin(), rule.rhs.end());
+        rhsOffsets.push_back((uint32_t)rhs.size());
+    }
+
+    TableFileHeader header = {};
+    memcpy(header.magic, TABLE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TABLE_FILE_VERSION;
+    header.terminalCount = symbols.terminalCount();
+    header.nonTerminalCount = symbols.nonTerminalCount();
+    header.productionCount = (int32_t)grammar.size();
+    header.startSymbol = startSymbol;
+    header.setWords = firstSet.wordCount();
+    header.grammarHash = grammarHash;
+    header.namesSize = names.size();
+    header.rhsCount = rhs.size();
+    header.conflictCount = conflicts.size();
+    vector<uint32_t> conflictWords;
+    for (const TableConflict& conflict : conflicts) {
+        conflictWords.push_back((uint32_t)conflict.nonTerminal);
+        conflictWords.push_back((uint32_t)conflict.terminal);
+        conflictWords.push_back(conflict.kept | (uint32_t)conflict.replaced << 16);
+        conflictWords.push_back((conflict.keptByFollow ? 1u : 0u) | (conflict.replacedByFollow ? 2u : 0u));
+    }
+
+    ofstream out(filename, ios::binary);
+    auto write = [&](const void* data, size_t size) {
+        static const char padding[8] = {};
+        out.write((const char*)data, size);
+        out.write(padding, (8 - size % 8) % 8);
+    };
+    write(&header, sizeof(header));
+    write(names.data(), names.size());
+    write(lhs.data(), lhs.size() * sizeof(int32_t));
+    write(rhsOffsets.data(), rhsOffsets.size() * sizeof(uint32_t));
+    write(rhs.data(), rhs.size() * sizeof(int32_t));
+    write(firstSet.row(0), firstSet.rawSize() * sizeof(uint64_t));
+    write(followSet.row(0), followSet.rawSize() * sizeof(uint64_t));
+    write(parseTable.cells, (size_t)header.nonTerminalCount * header.terminalCount * sizeof(ProductionIndex));
+    write(conflictWords.data(), conflictWords.size() * sizeof(uint32_t));
+    return (bool)out;
+}
+
+// Map a table file written by saveTables. Fails, leaving the parser empty,
+// if the file is missing, malformed, from another version or was built from
+// a grammar with a different hash.
+bool LL1Parser::loadTables(const string& filename, uint64_t grammarHash) {
+    PhaseTimer timer(stats.loadTablesNs);
+    if (!tableFile.open(filename) || tableFile.size() < sizeof(TableFileHeader)) return false;
+    TableFileHeader header;
+    memcpy(&header, tableFile.data(), sizeof(header));
+    if (memcmp(header.magic, TABLE_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != TABLE_FILE_VERSION
+        || header.grammarHash != grammarHash || header.terminalCount < 1 || header.nonTerminalCount < 0
+        || header.productionCount < 0 || header.setWords != header.terminalCount / 64 + 1
+        || header.conflictCount > tableFile.size()) {
+        tableFile.close();
+        return false;
+    }
+
+    size_t offset = 0;
+    bool ok = true;
+    auto section = [&](size_t size) -> const char* {
+        size_t start = offset;
+        offset += size + (8 - size % 8) % 8;
+        if (offset > tableFile.size()) ok = false;
+        return ok ? tableFile.data() + start : nullptr;
+    };
+    size_t setSize = (size_t)header.nonTerminalCount * header.setWords * sizeof(uint64_t);
+    section(sizeof(header));
+    const char* names = section(header.namesSize);
+    const int32_t* lhs = (const int32_t*)section(header.productionCount * sizeof(int32_t));
+    const uint32_t* rhsOffsets = (const uint32_t*)section((header.productionCount + 1) * sizeof(uint32_t));
+    const int32_t* rhs = (const int32_t*)section(header.rhsCount * sizeof(int32_t));
+    const char* first = section(setSize);
+    const char* follow = section(setSize);
+    const char* table = section((size_t)header.nonTerminalCount * header.terminalCount * sizeof(ProductionIndex));
+    const uint32_t* conflictWords = (const uint32_t*)section(header.conflictCount * 4 * sizeof(uint32_t));
+    for (int p = 0; ok && p < header.productionCount; ++p) {
+        ok = rhsOffsets[p] <= rhsOffsets[p + 1] && rhsOffsets[p + 1] <= header.rhsCount;
+    }
+    for (uint64_t c = 0; ok && c < header.conflictCount; ++c) {
+        const uint32_t* record = conflictWords + c * 4;
+        int nonTerminal = nonTerminalIndex((SymbolId)record[0]);
+        ok = !isTerminalId((SymbolId)record[0]) && nonTerminal < header.nonTerminalCount && record[1] < (uint32_t)header.terminalCount
+            && (int)(record[2] & 0xFFFF) < header.productionCount && (int)(record[2] >> 16) < header.productionCount;
+    }
+    if (ok && strict && header.conflictCount > 0) ok = false;
+    if (!ok) {
+        tableFile.close();
+        return false;
+    }
+
+    const char* name = names;
+    const char* namesEnd = names + header.namesSize;
+    auto nextName = [&]() {
+        const char* end = (const char*)memchr(name, '\0', namesEnd - name);
+        string_view result(name, (end ? end : namesEnd) - name);
+        name = end ? end + 1 : namesEnd;
+        return result;
+    };
+    symbols = SymbolTable();
+    nextName();
+    for (int t = 1; t < header.terminalCount; ++t) symbols.addTerminal(nextName());
+    for (int n = 0; n < header.nonTerminalCount; ++n) symbols.addNonTerminal(nextName());
+    symbols.buildPerfectHash();
+
+    // RHS arrays are used in place from the mapping
+    grammar.assign(header.productionCount, GrammarRule());
+    for (int p = 0; p < header.productionCount; ++p) {
+        grammar[p].lhs = lhs[p];
+        grammar[p].rhs.first = rhs + rhsOffsets[p];
+        grammar[p].rhs.count = rhsOffsets[p + 1] - rhsOffsets[p];
+    }
+    startSymbol = header.startSymbol;
+    firstSet.reset(header.nonTerminalCount, header.terminalCount);
+    followSet.reset(header.nonTerminalCount, header.terminalCount);
+    memcpy(firstSet.raw(), first, setSize);
+    memcpy(followSet.raw(), follow, setSize);
+    buildSuffixFirst();
+    parseTable.attach((const ProductionIndex*)table, header.nonTerminalCount, header.terminalCount);
+    conflicts.clear();
+    for (uint64_t c = 0; c < header.conflictCount; ++c) {
+        const uint32_t* record = conflictWords + c * 4;
+        conflicts.push_back(TableConflict{ (SymbolId)record[0], (SymbolId)record[1], (ProductionIndex)(record[2] & 0xFFFF),
+            (ProductionIndex)(record[2] >> 16), (record[3] & 1) != 0, (record[3] & 2) != 0 });
+    }
+    buildPushSequences();
+    return true;
+}
+
+// Start an incremental parse
+ParseSession LL1Parser::beginParse(const string& outputErrFile) const {
+    return ParseSession(*this, outputErrFile);
+}
+
+// Start an incremental parse that writes its errors to a caller's stream.
+// Sessions never modify the parser, so several threads can parse with it.
+ParseSession LL1Parser::beginParse(ostream& errors) const {
+    return ParseSession(*this, errors);
+}
+
+// Start an incremental parse that writes its errors to a caller's sink
+ParseSession LL1Parser::beginParse(DiagnosticSink& errors) const {
+    return ParseSession(*this, errors);
+}
+
+// Parse the token list using the LL(1) table
+bool LL1Parser::parseTokens(const vector<Token>& tokens, const string& outputErrFile, ParseStats* parseStats, ParseTree* tree, ParseTracer* tracer) const {
+    ParseSession session = beginParse(outputErrFile);
+    if (tree) session.buildTree(*tree, tokens.size());
+    if (tracer) session.trace(*tracer);
+    session.feed(tokens);
+    bool accepted = session.finish();
+    if (parseStats) *parseStats = session.getStats();
+    cout << (accepted ? "YES\n" : "NO\n");
+    return accepted;
+}
+
+// Parse a mapped token file using the LL(1) table
+bool LL1Parser::parseTokens(const TokenFile& tokens, const string& outputErrFile, ParseStats* parseStats, ParseTree* tree, ParseTracer* tracer) const {
+    ParseSession session = beginParse(outputErrFile);
+    if (tree) session.buildTree(*tree, tokens.size());
+    if (tracer) session.trace(*tracer);
+    session.feed(tokens.data(), tokens.size());
+    bool accepted = session.finish();
+    if (parseStats) *parseStats = session.getStats();
+    cout << (accepted ? "YES\n" : "NO\n");
+    return accepted;
+}
+
+// Chunks end just after a sync terminal near even splits of the input,
+// PARSE_CHUNK_MIN_TOKENS or more apart. Chunk 0 is parsed by the session
+// that reports errors; the others are speculative and are adopted one by
+// one, and the first that cannot be is parsed again from its start.
+bool LL1Parser::parseChunked(const TokenRef* tokens, size_t count, DiagnosticSink& errors, const SyncPoint& sync, int jobs, ParseStats* parseStats) const {
+    if (jobs < 1) jobs = (int)max(1u, thread::hardware_concurrency());
+    size_t chunks = min<size_t>((size_t)jobs * 4, count / PARSE_CHUNK_MIN_TOKENS + 1);
+    vector<size_t> starts(1, 0);
+    for (size_t k = 1; k < chunks; ++k) {
+        size_t i = max(count / chunks * k, starts.back() + PARSE_CHUNK_MIN_TOKENS);
+        while (i < count && tokens[i - 1].type != sync.terminal) ++i;
+        if (i >= count) break;
+        starts.push_back(i);
+    }
+    starts.push_back(count);
+
+    ParseSession session = beginParse(errors);
+    deque<BufferedSink> sinks(starts.size() - 2);
+    deque<ParseSession> speculative;
+    for (BufferedSink& sink : sinks) speculative.emplace_back(*this, sink).speculate(sync.restart);
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t k = next++; k + 1 < starts.size(); k = next++) {
+            if (k == 0) session.feed(tokens, starts[1]);
+            else speculative[k - 1].feed(tokens + starts[k], starts[k + 1] - starts[k]);
+        }
+    };
+    vector<thread> pool;
+    for (int j = 1; j < jobs && (size_t)j + 1 < starts.size(); ++j) pool.emplace_back(worker);
+    worker();
+    for (thread& t : pool) t.join();
+
+    size_t k = 1;
+    while (k + 1 < starts.size() && session.adopt(speculative[k - 1], sync.restart)) ++k;
+    if (k + 1 < starts.size()) session.feed(tokens + starts[k], count - starts[k]);
+    bool accepted = session.finish();
+    if (parseStats) *parseStats = session.getStats();
+    return accepted;
+}
+
+ParseTracer::ParseTracer(const LL1Parser& parser, ostream* out, size_t history)
+    : parser(parser), out(out), ring(TRACE_RING_STEPS), history(history) {
+    for (size_t p = 0; p < parser.productionCount(); ++p) productionTexts.push_back(parser.productionText((ProductionIndex)p));
+    drainer = thread(&ParseTracer::drain, this);
+}
+
+// Stop once every recorded step has been drained
+ParseTracer::~ParseTracer() {
+    stopping.store(true, memory_order_release);
+    drainer.join();
+}
+
+// The ring is full: let the drain thread run until a slot frees up
+void ParseTracer::waitForSpace(uint64_t next) {
+    while (next - (drainedTail = tail.load(memory_order_acquire)) >= TRACE_RING_STEPS) this_thread::yield();
+}
+
+// Steps are released back to the recording thread a batch at a time, after
+// they are formatted and copied into the history; formatted text goes out
+// in large writes
+void ParseTracer::drain() {
+    string text;
+    uint64_t next = 0;
+    while (true) {
+        uint64_t end = head.load(memory_order_acquire);
+        if (next == end) {
+            if (stopping.load(memory_order_acquire) && head.load(memory_order_acquire) == next) break;
+            if (out && !text.empty()) {
+                out->write(text.data(), text.size());
+                text.clear();
+            }
+            this_thread::sleep_for(chrono::microseconds(TRACE_DRAIN_IDLE_US));
+            continue;
+        }
+        for (; next < end; ++next) {
+            const TraceStep& step = ring[next & (TRACE_RING_STEPS - 1)];
+            if (out) format(text, next, step);
+            if (!history.empty()) history[next % history.size()] = step;
+        }
+        tail.store(next, memory_order_release);
+        if (out && text.size() >= TRACE_WRITE_BYTES) {
+            out->write(text.data(), text.size());
+            text.clear();
+        }
+    }
+    if (out) {
+        out->write(text.data(), text.size());
+        out->flush();
+    }
+}
+
+void ParseTracer::writeHistory(string& text) {
+    uint64_t end = head.load(memory_order_relaxed);
+    while (tail.load(memory_order_acquire) < end) this_thread::yield();
+    size_t count = (size_t)min<uint64_t>(end, history.size());
+    if (count == 0) return;
+    ((text += "Last ") += to_string(count)) += count == 1 ? " parse step:\n" : " parse steps:\n";
+    for (uint64_t step = end - count; step < end; ++step) {
+        text += "  ";
+        format(text, step, history[step % history.size()]);
+    }
+}
+
+// "step N line L: E' on '+': E' -> + T E'", or "...: match '+'"
+void ParseTracer::format(string& text, uint64_t step, const TraceStep& record) const {
+    ((((text += "step ") += to_string(step + 1)) += " line ") += to_string(record.line)) += ": ";
+    if (record.production == NO_PRODUCTION) {
+        ((text += "match '") += parser.getSymbols().name(record.lookahead)) += "'\n";
+        return;
+    }
+    (((((text += parser.getSymbols().name(record.top)) += " on '") += parser.getSymbols().name(record.lookahead)) += "': ") += productionTexts[record.production]) += '\n';
+}
+
+ParseSession::ParseSession(const LL1Parser& parser, const string& outputErrFile)
+    : parser(parser), sink(ownedSink.emplace<LazyFileSink>(outputErrFile)) {
+    start();
+}
+
+ParseSession::ParseSession(const LL1Parser& parser, ostream& errors)
+    : parser(parser), sink(ownedSink.emplace<StreamSink>(errors)) {
+    start();
+}
+
+ParseSession::ParseSession(const LL1Parser& parser, DiagnosticSink& errors)
+    : parser(parser), sink(errors) {
+    start();
+}
+
+// Reserve the stack once and push "$" and the start symbol
+void ParseSession::start() {
+    errorLimit = parser.errorLimit;
+    parseStack.reserve(PARSE_STACK_RESERVE);
+    parseStack.push_back(END_MARKER);
+    if (parser.startSymbol != NO_SYMBOL) parseStack.push_back(parser.startSymbol);
+}
+
+// Start recording a tree; the root node stands for the start symbol
+void ParseSession::buildTree(ParseTree& output, size_t expectedTokens) {
+    tree = &output;
+    tree->nodes.clear();
+    tree->nodes.reserve(expectedTokens * PARSE_TREE_NODES_PER_TOKEN + 1);
+    nodeStack.reserve(PARSE_STACK_RESERVE);
+    nodeStack.assign(1, UINT32_MAX);    // under "$"
+    if (parser.startSymbol == NO_SYMBOL) return;
+    tree->nodes.push_back(ParseNode{ parser.startSymbol, NO_PRODUCTION, 0, 0, 0, 0 });
+    nodeStack.push_back(0);
+}
+
+// Token type of a record from a lexer or from a TokenFile
+static SymbolId tokenType(const SymbolTable& symbols, const Token& token) { return symbols.find(token.type); }
+static SymbolId tokenType(const SymbolTable&, const TokenRef& token) { return token.type; }
+
+// Feed the next batch of tokens; false once the session has stopped at a
+// syntax error
+bool ParseSession::feed(const Token* tokens, size_t count) {
+    if (tracer) return tree ? feedBatch<true, true>(tokens, count) : feedBatch<false, true>(tokens, count);
+    return tree ? feedBatch<true, false>(tokens, count) : feedBatch<false, false>(tokens, count);
+}
+
+// Feed the next batch of tokens read from a TokenFile
+bool ParseSession::feed(const TokenRef* tokens, size_t count) {
+    if (tracer) return tree ? feedBatch<true, true>(tokens, count) : feedBatch<false, true>(tokens, count);
+    return tree ? feedBatch<true, false>(tokens, count) : feedBatch<false, false>(tokens, count);
+}
+
+// Whether a tree is recorded and steps are traced is decided once per
+// batch, so the loop without them is the same as if they did not exist
+template <bool BuildTree, bool Trace, class T>
+bool ParseSession::feedBatch(const T* tokens, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (!shift<BuildTree, Trace>(tokenType(parser.symbols, tokens[i]), tokens[i].line, tokens[i].value)) return false;
+    }
+    if (count > 0) {
+        lastLine = tokens[count - 1].line;
+        lastValue = string(tokens[count - 1].value);
+    }
+    return true;
+}
+
+// Expand nonterminals on top of the stack until the token can be matched
+template <bool BuildTree, bool Trace>
+inline bool ParseSession::shift(SymbolId type, int line, string_view value) {
+    if (error) return false;
+    while (true) {
+        SymbolId top = parseStack.back();
+        if (top == type) {
+            if (Trace) tracer->record(top, type, line, NO_PRODUCTION);
+            parseStack.pop_back();
+            if (BuildTree) {
+                ParseNode& node = tree->nodes[nodeStack.back()];
+                node.firstToken = (uint32_t)stats.matches;
+                node.tokenCount = 1;
+                nodeStack.pop_back();
+            }
+            ++stats.matches;
+            return true;
+        }
+        ProductionIndex production = isTerminalId(top) ? NO_PRODUCTION : parser.parseTable.lookup(top, type);
+        if (production == NO_PRODUCTION) {
+            Recovery action = recover<BuildTree>(top, type, line, value);
+            if (action == Recovery::Retry) continue;
+            return action == Recovery::Skip;
+        }
+        if (Trace) tracer->record(top, type, line, production);
+        expand<BuildTree>(production);
+    }
+}
+
+// Replace the nonterminal on top of the stack by a production's RHS. With
+// a tree, the RHS becomes consecutive child nodes of the expanded node.
+template <bool BuildTree>
+inline void ParseSession::expand(ProductionIndex production) {
+    parseStack.pop_back();
+    const SymbolId* symbols = parser.pushSymbols.data();
+    parseStack.insert(parseStack.end(), symbols + parser.pushStart[production], symbols + parser.pushStart[production + 1]);
+    ++stats.expansions;
+    stats.maxStackDepth = max(stats.maxStackDepth, parseStack.size());
+    if (BuildTree) {
+        vector<ParseNode>& nodes = tree->nodes;
+        uint32_t parent = nodeStack.back();
+        uint32_t firstChild = (uint32_t)nodes.size();
+        SymbolSpan rhs = parser.grammar[production].rhs;
+        nodeStack.pop_back();
+        for (SymbolId symbol : rhs) nodes.push_back(ParseNode{ symbol, NO_PRODUCTION, 0, 0, (uint32_t)stats.matches, 0 });
+        for (uint32_t i = rhs.size(); i-- > 0;) nodeStack.push_back(firstChild + i);
+        ParseNode& node = nodes[parent];
+        node.production = production;
+        node.firstChild = firstChild;
+        node.childCount = rhs.size();
+        node.firstToken = (uint32_t)stats.matches;
+    }
+}
+
+// Report a token that has no parse table entry
+void ParseSession::reportUnexpected(int line, string_view value) {
+    report.assign("Syntax error at line ") += to_string(line);
+    ((report += ": unexpected token '") += value) += "'\n";
+    sink.write(report);
+}
+
+// Report a token that is not the terminal on top of the stack
+void ParseSession::reportExpected(int line, string_view expected, string_view value) {
+    report.assign("Syntax error at line ") += to_string(line);
+    ((((report += ": expected '") += expected) += "' but found '") += value) += "'\n";
+    sink.write(report);
+}
+
+// Handle a syntax error with top on the stack and token type next
+// (END_MARKER at the end of input). The error is reported unless no token
+// was matched since the previous one, so a single mistake is reported
+// once. Up to the error limit the session then recovers in panic mode:
+// an expected terminal is taken as missing and popped; a nonterminal is
+// popped when the token is in its FOLLOW set, otherwise the token is
+// skipped; tokens after a leftover "$" are skipped.
+template <bool BuildTree>
+ParseSession::Recovery ParseSession::recover(SymbolId top, SymbolId type, int line, string_view value) {
+    if (top == SPECULATION_BASE) {
+        underflow = error = true;
+        return Recovery::Stop;
+    }
+    bool atEnd = type == END_MARKER;
+    if (stats.errors == 0 || stats.matches != matchesAtLastError) {
+        if (tracer) {
+            report.clear();
+            tracer->writeHistory(report);
+            sink.write(report);
+        }
+        if (!isTerminalId(top) || top == END_MARKER) reportUnexpected(line, value);
+        else if (atEnd) reportExpected(-1, parser.symbols.name(top), "$");
+        else reportExpected(line, parser.symbols.name(top), value);
+        matchesAtLastError = stats.matches;
+        if (++stats.errors >= errorLimit) {
+            error = true;
+            return Recovery::Stop;
+        }
+    }
+    if (top == END_MARKER) return Recovery::Skip;
+    bool synchronize = isTerminalId(top) || atEnd
+        || ((unsigned)type < (unsigned)parser.symbols.terminalCount() && TerminalSets::testBit(parser.followSet.row(nonTerminalIndex(top)), type));
+    if (!synchronize) return Recovery::Skip;
+    parseStack.pop_back();
+    if (BuildTree) nodeStack.pop_back();
+    return Recovery::Retry;
+}
+
+void ParseSession::speculate(const vector<SymbolId>& restart) {
+    parseStack.assign(1, SPECULATION_BASE);
+    parseStack.insert(parseStack.end(), restart.rbegin(), restart.rend());
+    errorLimit = 1;
+}
+
+bool ParseSession::adopt(const ParseSession& chunk, const vector<SymbolId>& restart) {
+    if (error || stats.errors > 0 || chunk.error || chunk.stats.errors > 0 || tree || parseStack.size() < restart.size()) return false;
+    if (!equal(restart.begin(), restart.end(), parseStack.rbegin())) return false;
+    parseStack.resize(parseStack.size() - restart.size());
+    parseStack.insert(parseStack.end(), chunk.parseStack.begin() + 1, chunk.parseStack.end());
+    stats.expansions += chunk.stats.expansions;
+    stats.matches += chunk.stats.matches;
+    stats.maxStackDepth = max(stats.maxStackDepth, parseStack.size());
+    if (chunk.stats.matches > 0) {
+        lastLine = chunk.lastLine;
+        lastValue = chunk.lastValue;
+    }
+    return true;
+}
+
+// Feed the "$" end marker; true if the whole input was accepted
+bool ParseSession::finish() {
+    if (!tree) return tracer ? finishAs<false, true>() : finishAs<false, false>();
+    bool accepted = tracer ? finishAs<true, true>() : finishAs<true, false>();
+    finishTree();
+    return accepted;
+}
+
+template <bool BuildTree, bool Trace>
+bool ParseSession::finishAs() {
+    if (error) return false;
+    while (true) {
+        SymbolId top = parseStack.back();
+        if (top == END_MARKER) return stats.errors == 0;
+        ProductionIndex production = isTerminalId(top) ? NO_PRODUCTION : parser.parseTable.lookup(top, END_MARKER);
+        if (production == NO_PRODUCTION) {
+            if (recover<BuildTree>(top, END_MARKER, lastLine, lastValue) == Recovery::Stop) return false;
+            continue;
+        }
+        if (Trace) tracer->record(top, END_MARKER, -1, production);
+        expand<BuildTree>(production);
+    }
+}
+
+// Close the token span of every expanded nonterminal at the end of its
+// last child. Children always come after their parent in the pool, so one
+// backwards pass sees each child before its parent.
+void ParseSession::finishTree() {
+    vector<ParseNode>& nodes = tree->nodes;
+    for (size_t i = nodes.size(); i-- > 0;) {
+        ParseNode& node = nodes[i];
+        if (node.childCount == 0) continue;
+        const ParseNode& last = nodes[node.firstChild + node.childCount - 1];
+        uint32_t end = max(last.firstToken + last.tokenCount, node.firstToken);
+        node.tokenCount = end - node.firstToken;
+    }
+}
+
+// Sparse rows packed into one array by row displacement: entry (row,
+// column) lives at base[row] + column when check there names the row.
+// Zero stands for an empty entry.
+struct DisplacedTable {
+    vector<uint32_t> base;
+    vector<int32_t> value, check;
+
+    void pack(vector<vector<pair<int, int32_t>>>& rows, int columns);
+    int32_t lookup(int row, int column) const {
+        size_t i = base[row] + (size_t)column;
+        return check[i] == row ? value[i] : 0;
+    }
+    size_t memoryUsage() const { return base.size() * sizeof(uint32_t) + 2 * value.size() * sizeof(int32_t); }
+};
+
+// Place the rows densest first, each at the lowest base where all of its
+// entries fall on free slots; the arrays end columns past the last base so
+// lookups need no bounds check
+void DisplacedTable::pack(vector<vector<pair<int, int32_t>>>& rows, int columns) {
+    vector<uint32_t> order(rows.size());
+    for (size_t r = 0; r < rows.size(); ++r) {
+        order[r] = (uint32_t)r;
+        sort(rows[r].begin(), rows[r].end());
+    }
+    stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return rows[a].size() > rows[b].size(); });
+    base.assign(rows.size(), 0);
+    value.clear();
+    check.clear();
+    size_t firstFree = 0, lastBase = 0;
+    for (uint32_t r : order) {
+        const vector<pair<int, int32_t>>& entries = rows[r];
+        if (entries.empty()) continue;
+        // slots below firstFree are all taken, so the lowest column cannot go there
+        size_t b = firstFree > (size_t)entries.front().first ? firstFree - entries.front().first : 0;
+        for (;; ++b) {
+            bool fits = true;
+            for (const pair<int, int32_t>& entry : entries) {
+                size_t i = b + entry.first;
+                if (i < check.size() && check[i] >= 0) { fits = false; break; }
+            }
+            if (fits) break;
+        }
+        base[r] = (uint32_t)b;
+        for (const pair<int, int32_t>& entry : entries) {
+            size_t i = b + entry.first;
+            if (i >= check.size()) {
+                value.resize(i + 1, 0);
+                check.resize(i + 1, -1);
+            }
+            value[i] = entry.second;
+            check[i] = (int32_t)r;
+        }
+        while (firstFree < check.size() && check[firstFree] >= 0) ++firstFree;
+        lastBase = max(lastBase, b);
+    }
+    value.resize(lastBase + columns, 0);
+    check.resize(lastBase + columns, -1);
+}
+
+// An ACTION entry of an LALRParser claimed twice. A shift/reduce conflict
+// keeps the shift, a reduce/reduce conflict the earlier production.
+struct ActionConflict {
+    uint32_t state;
+    SymbolId terminal;
+    bool shiftReduce;
+    uint32_t kept, replaced;    // productions; kept is unused for a shift
+};
+
+// LALR(1) parser over the grammar, symbols and FIRST sets of an LL1Parser,
+// which must outlive it, so it reads the same token files. Left-recursive
+// and other non-LL(1) grammars need no rewriting.
+class LALRParser {
+public:
+    explicit LALRParser(const LL1Parser& grammar) : source(grammar) {}
+    // Make build() throw when the grammar is not LALR(1)
+    void setStrict(bool enabled) { strict = enabled; }
+    // Build the LR(0) automaton, its LALR(1) lookaheads and the packed
+    // tables. Call once the LL1Parser has its FIRST sets (computeFirst or
+    // loadTables).
+    void build();
+    // Parse up to the first error, reported as ParseSession reports a
+    // token no production can start with
+    bool parse(const TokenRef* tokens, size_t count, DiagnosticSink& errors) const;
+    size_t stateCount() const { return states; }
+    const vector<ActionConflict>& getConflicts() const { return conflicts; }
+    void writeConflicts(ostream& out) const;
+    size_t memoryUsage() const;
+
+private:
+    const LL1Parser& source;
+    bool strict = false;
+    size_t states = 0;
+    int terminals = 0;
+    uint32_t accept = 0;    // production "start' -> start", after the grammar's
+    // RHS length and LHS nonterminal index (the GOTO column) by production
+    vector<uint32_t> rhsLength;
+    vector<int32_t> lhsIndex;
+    // ACTION entries are s + 1 to shift to state s and ~p to reduce by
+    // production p; GOTO entries are the target state + 1
+    DisplacedTable action, gotoTable;
+    // ~p for a state whose only action is reducing by p, taken without
+    // looking at the token; an error then shows in the state reduced to,
+    // before the token is shifted, so it is reported at the same token
+    vector<int32_t> defaultReduce;
+    vector<ActionConflict> conflicts;
+};
+
+// Items are (production, dot) pairs packed as production << 32 | dot, and
+// kernels are kept sorted so equal kernels have equal bytes. Lookaheads
+// are propagated over the LR(0) automaton with the FIRST sets of the RHS
+// suffixes until nothing changes, which gives the sets of merging LR(1)
+// states with equal cores without building those states.
+void LALRParser::build() {
+    const vector<GrammarRule>& grammar = source.grammar;
+    terminals = source.symbols.terminalCount();
+    int nonTerminals = source.symbols.nonTerminalCount();
+    accept = (uint32_t)grammar.size();
+    SymbolSpan acceptRhs;
+    if (source.startSymbol != NO_SYMBOL) acceptRhs = SymbolSpan{ &source.startSymbol, 1 };
+    auto rhsOf = [&](uint32_t production) { return production == accept ? acceptRhs : grammar[production].rhs; };
+    vector<vector<uint32_t>> productionsOf(nonTerminals);
+    for (size_t p = 0; p < grammar.size(); ++p) productionsOf[nonTerminalIndex(grammar[p].lhs)].push_back((uint32_t)p);
+
+    // Edges of a state along which lookaheads flow, as pools with a start
+    // offset per state. An item is named by its kernel index, or by ~slot
+    // for the non-kernel items of the slot's nonterminal, which share one
+    // lookahead set.
+    struct Spread { int32_t from; uint32_t slot, production, dot; bool nullable; };   // FIRST(rhs[dot + 1..]) into slot
+    struct Pass { int32_t from; uint32_t state, kernel; };     // into a successor's kernel item
+    struct Reduce { int32_t from; uint32_t production; };
+    struct Shift { SymbolId symbol; uint32_t state; };
+    vector<Spread> spreads;
+    vector<Pass> passes;
+    vector<Reduce> reduces;
+    vector<Shift> shifts;
+    vector<uint32_t> spreadStart, passStart, reduceStart, shiftStart, slotCount;
+    vector<uint64_t> kernelItems;
+    vector<uint32_t> kernelStart{ 0 };
+    unordered_map<string, uint32_t> stateOf;
+    auto itemOf = [](uint32_t production, uint32_t dot) { return (uint64_t)production << 32 | dot; };
+    auto addState = [&](vector<uint64_t>& kernel) {
+        sort(kernel.begin(), kernel.end());
+        auto inserted = stateOf.emplace(string((const char*)kernel.data(), kernel.size() * sizeof(uint64_t)), (uint32_t)kernelStart.size() - 1);
+        if (inserted.second) {
+            kernelItems.insert(kernelItems.end(), kernel.begin(), kernel.end());
+            kernelStart.push_back((uint32_t)kernelItems.size());
+        }
+        return inserted.first->second;
+    };
+    vector<uint64_t> kernel{ itemOf(accept, 0) };
+    addState(kernel);
+
+    // Successor kernels of one state, grouped by the symbol after the dot
+    vector<int> terminalGroup(terminals, -1), nonTerminalGroup(nonTerminals, -1), slotOf(nonTerminals, -1);
+    vector<SymbolId> groupSymbol;
+    vector<vector<pair<int32_t, uint64_t>>> groups;
+    vector<int> slotNonTerminal;
+    for (uint32_t s = 0; s + 1 < kernelStart.size(); ++s) {
+        spreadStart.push_back((uint32_t)spreads.size());
+        passStart.push_back((uint32_t)passes.size());
+        reduceStart.push_back((uint32_t)reduces.size());
+        shiftStart.push_back((uint32_t)shifts.size());
+        auto visit = [&](int32_t from, uint32_t production, uint32_t dot) {
+            SymbolSpan rhs = rhsOf(production);
+            if (dot == rhs.count) {
+                reduces.push_back(Reduce{ from, production });
+                return;
+            }
+            SymbolId symbol = rhs.first[dot];
+            int& group = isTerminalId(symbol) ? terminalGroup[symbol] : nonTerminalGroup[nonTerminalIndex(symbol)];
+            if (group < 0) {
+                group = (int)groupSymbol.size();
+                groupSymbol.push_back(symbol);
+                if (groups.size() <= (size_t)group) groups.emplace_back();
+            }
+            groups[group].emplace_back(from, itemOf(production, dot + 1));
+            if (isTerminalId(symbol)) return;
+            int& slot = slotOf[nonTerminalIndex(symbol)];
+            if (slot < 0) {
+                slot = (int)slotNonTerminal.size();
+                slotNonTerminal.push_back(nonTerminalIndex(symbol));
+            }
+            bool nullable = production == accept || source.firstOfSuffix(production, dot + 1).nullable;
+            spreads.push_back(Spread{ from, (uint32_t)slot, production, dot, nullable });
+        };
+        for (uint32_t k = kernelStart[s]; k < kernelStart[s + 1]; ++k) {
+            uint64_t item = kernelItems[k];
+            visit((int32_t)(k - kernelStart[s]), (uint32_t)(item >> 32), (uint32_t)item);
+        }
+        for (size_t j = 0; j < slotNonTerminal.size(); ++j) {
+            for (uint32_t p : productionsOf[slotNonTerminal[j]]) visit(~(int32_t)j, p, 0);
+        }
+        for (size_t g = 0; g < groupSymbol.size(); ++g) {
+            kernel.clear();
+            for (const pair<int32_t, uint64_t>& entry : groups[g]) kernel.push_back(entry.second);
+            uint32_t target = addState(kernel);
+            shifts.push_back(Shift{ groupSymbol[g], target });
+            const uint64_t* first = kernelItems.data() + kernelStart[target];
+            const uint64_t* last = kernelItems.data() + kernelStart[target + 1];
+            for (const pair<int32_t, uint64_t>& entry : groups[g]) {
+                passes.push_back(Pass{ entry.first, target, (uint32_t)(lower_bound(first, last, entry.second) - kernelItems.data()) });
+            }
+            groups[g].clear();
+            int& group = isTerminalId(groupSymbol[g]) ? terminalGroup[groupSymbol[g]] : nonTerminalGroup[nonTerminalIndex(groupSymbol[g])];
+            group = -1;
+        }
+        groupSymbol.clear();
+        for (int n : slotNonTerminal) slotOf[n] = -1;
+        slotCount.push_back((uint32_t)slotNonTerminal.size());
+        slotNonTerminal.clear();
+    }
+    states = kernelStart.size() - 1;
+    spreadStart.push_back((uint32_t)spreads.size());
+    passStart.push_back((uint32_t)passes.size());
+    reduceStart.push_back((uint32_t)reduces.size());
+    shiftStart.push_back((uint32_t)shifts.size());
+
+    TerminalSets kernelSets, slotSets;
+    kernelSets.reset((int)kernelItems.size(), terminals);
+    slotSets.reset((int)*max_element(slotCount.begin(), slotCount.end()), terminals);
+    TerminalSets::setBit(kernelSets.row(0), END_MARKER);
+    auto lookahead = [&](uint32_t s, int32_t from) -> const uint64_t* {
+        return from >= 0 ? kernelSets.row(kernelStart[s] + from) : slotSets.row(~from);
+    };
+    // Lookaheads of the non-kernel items of state s from those of its kernel
+    auto closeState = [&](uint32_t s) {
+        if (slotCount[s] == 0) return;
+        fill(slotSets.row(0), slotSets.row(0) + (size_t)slotCount[s] * slotSets.wordCount(), 0);
+        for (uint32_t e = spreadStart[s]; e < spreadStart[s + 1]; ++e) {
+            if (spreads[e].production != accept) source.unionFirstOf(source.firstOfSuffix(spreads[e].production, spreads[e].dot + 1), slotSets.row(spreads[e].slot));
+        }
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (uint32_t e = spreadStart[s]; e < spreadStart[s + 1]; ++e) {
+                if (spreads[e].nullable && slotSets.unionWithoutEpsilon(slotSets.row(spreads[e].slot), lookahead(s, spreads[e].from))) changed = true;
+            }
+        }
+    };
+    vector<uint32_t> worklist;
+    vector<char> queued(states, 1);
+    for (size_t s = states; s-- > 0;) worklist.push_back((uint32_t)s);
+    while (!worklist.empty()) {
+        uint32_t s = worklist.back();
+        worklist.pop_back();
+        queued[s] = 0;
+        closeState(s);
+        for (uint32_t e = passStart[s]; e < passStart[s + 1]; ++e) {
+            const Pass& pass = passes[e];
+            if (kernelSets.unionWithoutEpsilon(kernelSets.row(pass.kernel), lookahead(s, pass.from)) && !queued[pass.state]) {
+                queued[pass.state] = 1;
+                worklist.push_back(pass.state);
+            }
+        }
+    }
+
+    vector<vector<pair<int, int32_t>>> actionRows(states), gotoRows(states);
+    vector<int32_t> row(terminals);
+    defaultReduce.assign(states, 0);
+    conflicts.clear();
+    for (uint32_t s = 0; s < states; ++s) {
+        closeState(s);
+        fill(row.begin(), row.end(), 0);
+        for (uint32_t e = shiftStart[s]; e < shiftStart[s + 1]; ++e) {
+            SymbolId symbol = shifts[e].symbol;
+            if (isTerminalId(symbol)) row[symbol] = (int32_t)shifts[e].state + 1;
+            else gotoRows[s].emplace_back(nonTerminalIndex(symbol), (int32_t)shifts[e].state + 1);
+        }
+        for (uint32_t e = reduceStart[s]; e < reduceStart[s + 1]; ++e) {
+            uint32_t production = reduces[e].production;
+            kernelSets.forEachTerminal(lookahead(s, reduces[e].from), [&](SymbolId terminal) {
+                int32_t& entry = row[terminal];
+                if (entry == 0) {
+                    entry = ~(int32_t)production;
+                } else if (entry > 0) {
+                    conflicts.push_back(ActionConflict{ s, terminal, true, 0, production });
+                } else {
+                    uint32_t other = ~entry;
+                    conflicts.push_back(ActionConflict{ s, terminal, false, min(other, production), max(other, production) });
+                    entry = ~(int32_t)min(other, production);
+                }
+            });
+        }
+        for (int t = 0; t < terminals; ++t) {
+            if (row[t] != 0) actionRows[s].emplace_back(t, row[t]);
+        }
+        int32_t only = actionRows[s].empty() ? 0 : actionRows[s].front().second;
+        for (const pair<int, int32_t>& entry : actionRows[s]) {
+            if (entry.second != only) only = 0;
+        }
+        defaultReduce[s] = only < 0 && ~only != (int32_t)accept ? only : 0;
+    }
+    action.pack(actionRows, terminals);
+    gotoTable.pack(gotoRows, nonTerminals);
+    rhsLength.assign(grammar.size() + 1, 0);
+    lhsIndex.assign(grammar.size() + 1, -1);
+    for (size_t p = 0; p < grammar.size(); ++p) {
+        rhsLength[p] = grammar[p].rhs.count;
+        lhsIndex[p] = nonTerminalIndex(grammar[p].lhs);
+    }
+    rhsLength[accept] = acceptRhs.count;
+    if (strict && !conflicts.empty()) {
+        throw runtime_error("grammar is not LALR(1): " + to_string(conflicts.size()) + (conflicts.size() == 1 ? " table conflict" : " table conflicts"));
+    }
+}
+
+// One state stack entry per symbol shifted or reduced to; a reduce pops
+// the RHS length and pushes GOTO of the uncovered state
+bool LALRParser::parse(const TokenRef* tokens, size_t count, DiagnosticSink& errors) const {
+    vector<int32_t> stack;
+    stack.reserve(PARSE_STACK_RESERVE);
+    stack.push_back(0);
+    size_t next = 0;
+    while (true) {
+        int32_t entry = defaultReduce[stack.back()];
+        if (entry == 0) {
+            SymbolId type = next < count ? tokens[next].type : END_MARKER;
+            entry = (unsigned)type < (unsigned)terminals ? action.lookup(stack.back(), type) : 0;
+        }
+        if (entry > 0) {
+            stack.push_back(entry - 1);
+            ++next;
+            continue;
+        }
+        if (entry == 0) break;
+        uint32_t production = ~entry;
+        if (production == accept) return true;
+        stack.resize(stack.size() - rhsLength[production]);
+        stack.push_back(gotoTable.lookup(stack.back(), lhsIndex[production]) - 1);
+    }
+    int line = -1;
+    string_view value = "$";
+    if (next < count || count > 0) {
+        const TokenRef& token = tokens[next < count ? next : count - 1];
+        line = token.line;
+        value = token.value;
+    }
+    string report = "Syntax error at line " + to_string(line);
+    ((report += ": unexpected token '") += value) += "'\n";
+    errors.write(report);
+    return false;
+}
+
+void LALRParser::writeConflicts(ostream& out) const {
+    auto text = [&](uint32_t production) { return production == accept ? string("accept") : source.productionText((ProductionIndex)production); };
+    for (const ActionConflict& conflict : conflicts) {
+        out << "LALR(1) " << (conflict.shiftReduce ? "shift/reduce" : "reduce/reduce") << " conflict in state " << conflict.state
+            << " on " << source.symbols.name(conflict.terminal) << ": ";
+        if (conflict.shiftReduce) out << "shift and reduce " << text(conflict.replaced) << ", using shift\n";
+        else out << "reduce " << text(conflict.kept) << " and reduce " << text(conflict.replaced) << ", using " << text(conflict.kept) << '\n';
+    }
+}
+
+size_t LALRParser::memoryUsage() const {
+    return sizeof(*this) + action.memoryUsage() + gotoTable.memoryUsage() + defaultReduce.size() * sizeof(int32_t)
+        + rhsLength.size() * (sizeof(uint32_t) + sizeof(int32_t))
+        + conflicts.size() * sizeof(ActionConflict);
+}
+
+// Token files named by a list file (one path per line) or every regular
+// file in a directory, in name order
+vector<string> listTokenFiles(const string& source) {
+    vector<string> paths;
+    error_code ec;
+    if (filesystem::is_directory(source, ec)) {
+        for (const auto& entry : filesystem::directory_iterator(source, ec)) {
+            if (entry.is_regular_file(ec)) paths.push_back(entry.path().string());
+        }
+        sort(paths.begin(), paths.end());
+        return paths;
+    }
+    ifstream list(source);
+    string line;
+    while (getline(list, line)) {
+        while (!line.empty() && isspace((unsigned char)line.back())) line.pop_back();
+        if (!line.empty()) paths.push_back(line);
+    }
+    return paths;
+}
+
+// Pending batch output is written once it reaches this size
+const size_t BATCH_WRITE_BYTES = 1 << 16;
+
+// Output of a batch run, shared by its workers. Results are written in
+// input order as soon as every earlier one is in: "path YES|NO" lines to
+// stdout and each error line, prefixed with its path, to the error file.
+// Both go out in blocks of BATCH_WRITE_BYTES, and the error file is only
+// created once there is an error to write.
+class BatchWriter {
+public:
+    BatchWriter(const vector<string>& paths, const string& errorFile)
+        : paths(paths), results(paths.size()), errFile(errorFile) {}
+    void add(size_t index, bool accepted, string errors);
+    void flush();
+
+private:
+    struct Result {
+        bool done = false, accepted = false;
+        string errors;
+    };
+    void writePending();
+
+    const vector<string>& paths;
+    mutex lock;
+    vector<Result> results;
+    size_t next = 0;        // first result not yet written
+    string out, err;
+    LazyFileSink errFile;
+};
+
+// Record the result of paths[index]
+void BatchWriter::add(size_t index, bool accepted, string errors) {
+    lock_guard<mutex> guard(lock);
+    results[index] = Result{ true, accepted, move(errors) };
+    for (; next < results.size() && results[next].done; ++next) {
+        Result& result = results[next];
+        (out += paths[next]) += result.accepted ? " YES\n" : " NO\n";
+        for (size_t begin = 0; begin < result.errors.size();) {
+            size_t end = min(result.errors.find('\n', begin), result.errors.size());
+            ((err += paths[next]) += ": ").append(result.errors, begin, end - begin) += '\n';
+            begin = end + 1;
+        }
+        string().swap(result.errors);
+    }
+    if (out.size() + err.size() >= BATCH_WRITE_BYTES) writePending();
+}
+
+// Write everything recorded so far
+void BatchWriter::flush() {
+    lock_guard<mutex> guard(lock);
+    writePending();
+    cout.flush();
+}
+
+void BatchWriter::writePending() {
+    cout.write(out.data(), out.size());
+    if (!err.empty()) errFile.write(err);
+    out.clear();
+    err.clear();
+}
+
+// Check many token files against one grammar on a pool of threads. The
+// tables are shared read-only; each worker reuses one error buffer, and
+// the results go through a BatchWriter.
+int runBatch(const LL1Parser& parser, const string& source, const string& outputErrFile, int jobs) {
+    vector<string> paths = listTokenFiles(source);
+    BatchWriter writer(paths, outputErrFile);
+    atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        BufferedSink errors;
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            TokenFile tokens;
+            if (!tokens.open(paths[i], parser.getSymbols())) {
+                writer.add(i, false, "Cannot open token file\n");
+                continue;
+            }
+            errors.clear();
+            ParseSession session = parser.beginParse(errors);
+            session.feed(tokens.data(), tokens.size());
+            bool accepted = session.finish();
+            writer.add(i, accepted, errors.text());
+        }
+    };
+    if (jobs < 1) jobs = (int)max(1u, thread::hardware_concurrency());
+    vector<thread> pool;
+    for (int j = 1; j < jobs; ++j) pool.emplace_back(worker);
+    worker();
+    for (thread& t : pool) t.join();
+    writer.flush();
+    return 0;
+}
+
+// Settings a --serve run applies to every grammar it compiles
+struct ServeOptions {
+    bool ebnf = false, strict = false, reduce = false, rewrite = false;
+    size_t maxErrors = 1;
+    int jobs = 0;
+    size_t cacheBytes = 256u << 20;
+};
+
+// A grammar compiled for --serve: the tables, or why there are none
+struct CompiledGrammar {
+    shared_ptr<const LL1Parser> parser;
+    string error;
+};
+
+// Compiled grammars shared by the workers of --serve, keyed by a hash of
+// the grammar text, so an edited file is compiled afresh. The first request
+// for a grammar compiles it while later ones wait for the result. Once the
+// tables exceed the byte budget the least recently used are dropped; a
+// request still parsing with one keeps it alive. Failed compilations are
+// not kept.
+class GrammarCache {
+public:
+    explicit GrammarCache(const ServeOptions& options) : options(options) {}
+    CompiledGrammar get(const string& path);
+    void writeStats(ostream& out);
+
+private:
+    struct Entry {
+        shared_future<CompiledGrammar> result;
+        list<uint64_t>::iterator recent;
+        size_t bytes = 0;       // 0 while compiling
+    };
+    CompiledGrammar compile(const string& path, string_view text) const;
+    void evict();
+
+    const ServeOptions& options;
+    mutex lock;
+    unordered_map<uint64_t, Entry> entries;
+    list<uint64_t> recentlyUsed;    // most recent first
+    size_t totalBytes = 0;
+    uint64_t hits = 0, misses = 0, evictions = 0;
+};
+
+// The grammar is copied out once so the key and the tables come from the
+// same bytes even if the file is rewritten while it is being served
+CompiledGrammar GrammarCache::get(const string& path) {
+    MappedFile file;
+    if (!filesystem::is_regular_file(path) || !file.open(path)) return CompiledGrammar{ nullptr, "Cannot open grammar file" };
+    string text(file.data(), file.size());
+    file.close();
+    uint64_t key = hashBytes(text) ^ (options.ebnf ? 0x9e3779b97f4a7c15ull : 0) ^ (options.reduce ? 0xc2b2ae3d27d4eb4full : 0)
+        ^ (options.rewrite ? 0x165667b19e3779f9ull : 0);
+    unique_lock<mutex> guard(lock);
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+        ++hits;
+        recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, found->second.recent);
+        shared_future<CompiledGrammar> result = found->second.result;
+        guard.unlock();
+        return result.get();
+    }
+    ++misses;
+    promise<CompiledGrammar> pending;
+    recentlyUsed.push_front(key);
+    entries[key] = Entry{ pending.get_future().share(), recentlyUsed.begin(), 0 };
+    guard.unlock();
+
+    CompiledGrammar compiled = compile(path, text);
+    pending.set_value(compiled);
+    guard.lock();
+    Entry& entry = entries[key];
+    if (!compiled.parser) {
+        recentlyUsed.erase(entry.recent);
+        entries.erase(key);
+        return compiled;
+    }
+    entry.bytes = max<size_t>(compiled.parser->memoryUsage(), 1);
+    totalBytes += entry.bytes;
+    evict();
+    return compiled;
+}
+
+// Build the tables as a single run of main would; conflicts go to stderr
+CompiledGrammar GrammarCache::compile(const string& path, string_view text) const {
+    auto parser = make_shared<LL1Parser>();
+    parser->setEbnf(options.ebnf);
+    parser->setAnalysisThreads(1);
+    parser->setErrorLimit(options.maxErrors);
+    parser->setStrict(options.strict);
+    CompiledGrammar compiled;
+    try {
+        parser->loadGrammarText(text);
+        if (options.rewrite) parser->rewriteGrammar();
+        if (options.reduce) parser->reduceGrammar();
+        parser->computeFirst();
+        parser->computeFollow();
+        parser->buildParseTable();
+        compiled.parser = parser;
+    }
+    catch (const exception& e) {
+        compiled.error = e.what();
+    }
+    ostringstream conflicts;
+    parser->writeConflicts(conflicts);
+    if (!conflicts.str().empty()) cerr << (path + ":\n" + conflicts.str()) << flush;
+    return compiled;
+}
+
+// Drop least recently used grammars until the rest fit the budget
+void GrammarCache::evict() {
+    for (auto it = recentlyUsed.end(); totalBytes > options.cacheBytes && it != recentlyUsed.begin();) {
+        --it;
+        Entry& entry = entries[*it];
+        if (entry.bytes == 0) continue;
+        totalBytes -= entry.bytes;
+        ++evictions;
+        entries.erase(*it);
+        it = recentlyUsed.erase(it);
+    }
+}
+
+// Cache counters as JSON for --serve --stats
+void GrammarCache::writeStats(ostream& out) {
+    lock_guard<mutex> guard(lock);
+    out << "{\"grammars\": " << entries.size() << ", \"cache_bytes\": " << totalBytes << ", \"hits\": " << hits
+        << ", \"misses\": " << misses << ", \"evictions\": " << evictions << "}" << endl;
+}
+
+// One request of a --serve run: tokens from a file, or sent inline
+struct ServeRequest {
+    string id, grammar, tokenPath, tokens;
+    bool inlineTokens = false, valid = true;
+};
+
+// Read the next request from in. A request is one line
+//   id grammar.txt tokens.txt
+//   id grammar.txt - N        followed by N lines of tokens
+// False at the end of the input.
+bool readServeRequest(istream& in, ServeRequest& request) {
+    string line;
+    while (getline(in, line)) {
+        istringstream words(line);
+        request = ServeRequest();
+        if (!(words >> request.id)) continue;
+        string count;
+        request.valid = (bool)(words >> request.grammar >> request.tokenPath);
+        if (request.valid && request.tokenPath == "-") {
+            request.inlineTokens = true;
+            request.valid = (bool)(words >> count) && !count.empty() && all_of(count.begin(), count.end(), [](char c) { return c >= '0' && c <= '9'; });
+            for (size_t n = request.valid ? strtoull(count.c_str(), nullptr, 10) : 0; n > 0 && getline(in, line); --n) {
+                (request.tokens += line) += '\n';
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+// Requests read but not yet taken by a --serve worker are bounded by this
+const size_t SERVE_QUEUE_LIMIT = 256;
+
+// Long-running mode for --serve: read requests from stdin and check each
+// against its grammar on a pool of threads, with the compiled grammars in
+// a GrammarCache. Each answer is written and flushed whole as it completes,
+// so answers can come out of order: "id YES|NO" followed by every error
+// line prefixed with "id: ".
+int runServer(const ServeOptions& options, bool printStats) {
+    GrammarCache cache(options);
+    mutex queueLock, outputLock;
+    condition_variable queued, taken;
+    deque<ServeRequest> queue;
+    bool closed = false;
+
+    auto answer = [&](const ServeRequest& request) {
+        bool accepted = false;
+        string errors;
+        CompiledGrammar compiled;
+        if (!request.valid) errors = "Bad request\n";
+        else if (!(compiled = cache.get(request.grammar)).parser) errors = compiled.error + '\n';
+        else {
+            const LL1Parser& parser = *compiled.parser;
+            TokenFile tokens;
+            if (request.inlineTokens) tokens.assign(request.tokens, parser.getSymbols());
+            if (!request.inlineTokens && !tokens.open(request.tokenPath, parser.getSymbols())) errors = "Cannot open token file\n";
+            else {
+                BufferedSink sink;
+                ParseSession session = parser.beginParse(sink);
+                session.feed(tokens.data(), tokens.size());
+                accepted = session.finish();
+                errors = sink.text();
+            }
+        }
+        string out = request.id + (accepted ? " YES\n" : " NO\n");
+        for (size_t begin = 0; begin < errors.size();) {
+            size_t end = min(errors.find('\n', begin), errors.size());
+            ((out += request.id) += ": ").append(errors, begin, end - begin) += '\n';
+            begin = end + 1;
+        }
+        lock_guard<mutex> guard(outputLock);
+        cout << out << flush;
+    };
+    auto worker = [&]() {
+        for (;;) {
+            unique_lock<mutex> guard(queueLock);
+            queued.wait(guard, [&]() { return closed || !queue.empty(); });
+            if (queue.empty()) return;
+            ServeRequest request = move(queue.front());
+            queue.pop_front();
+            guard.unlock();
+            taken.notify_one();
+            answer(request);
+        }
+    };
+
+    int jobs = options.jobs < 1 ? (int)max(1u, thread::hardware_concurrency()) : options.jobs;
+    vector<thread> pool;
+    for (int j = 0; j < jobs; ++j) pool.emplace_back(worker);
+    ServeRequest request;
+    while (readServeRequest(cin, request)) {
+        unique_lock<mutex> guard(queueLock);
+        taken.wait(guard, [&]() { return queue.size() < SERVE_QUEUE_LIMIT; });
+        queue.push_back(move(request));
+        guard.unlock();
+        queued.notify_one();
+    }
+    {
+        lock_guard<mutex> guard(queueLock);
+        closed = true;
+    }
+    queued.notify_all();
+    for (thread& t : pool) t.join();
+    if (printStats) cache.writeStats(cerr);
+    return 0;
+}
+
+// Heap allocations since start-up, reported by --bench. They are only
+// counted in builds with LL1_COUNT_ALLOCATIONS defined: counting replaces
+// the global operator new, so every allocation of every mode would pay for
+// it. The replacements are kept out of line so call sites never see malloc
+// and free paired with new and delete.
+#ifdef LL1_COUNT_ALLOCATIONS
+#ifdef _MSC_VER
+#define ALLOCATION_HOOK __declspec(noinline)
+#else
+#define ALLOCATION_HOOK __attribute__((noinline))
+#endif
+
+static atomic<uint64_t> allocationCount(0);
+
+ALLOCATION_HOOK void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+
+ALLOCATION_HOOK void operator delete(void* p) noexcept {
+    free(p);
+}
+
+ALLOCATION_HOOK void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+const bool COUNTS_ALLOCATIONS = true;
+
+inline uint64_t allocationsSoFar() {
+    return allocationCount.load(memory_order_relaxed);
+}
+#else
+const bool COUNTS_ALLOCATIONS = false;
+
+inline uint64_t allocationsSoFar() {
+    return 0;
+}
+#endif
+
+// Peak resident set size of the process in KB
+uint64_t peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return (uint64_t)usage.ru_maxrss;
+#endif
+}
+
+// A directory of its own under the system temp directory for the scratch
+// files of one --bench or --fuzz run, removed with everything in it when
+// the run ends. The name carries the process ID and a random suffix, so
+// concurrent runs never share input files.
+class ScratchDirectory {
+public:
+    explicit ScratchDirectory(const string& prefix) {
+#ifdef _WIN32
+        unsigned long pid = GetCurrentProcessId();
+#else
+        unsigned long pid = (unsigned long)getpid();
+#endif
+        random_device entropy;
+        for (;;) {
+            path = filesystem::temp_directory_path() / (prefix + "-" + to_string(pid) + "-" + to_string(entropy()));
+            if (filesystem::create_directory(path)) break;
+        }
+    }
+    ~ScratchDirectory() {
+        error_code ignored;
+        filesystem::remove_all(path, ignored);
+    }
+    ScratchDirectory(const ScratchDirectory&) = delete;
+    ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+    string file(const string& name) const { return (path / name).string(); }
+
+private:
+    filesystem::path path;
+};
+
+// Steering and seed for the token streams TokenGenerator derives
+struct GeneratorOptions {
+    size_t depth = 64;      // parse stack depth to steer towards
+    uint64_t seed = 1;
+};
+
+// Candidate terminals TokenGenerator compares when it steers a pick
+const size_t GENERATOR_CANDIDATES = 8;
+// Generated streams start a new line after this many tokens on average
+const uint32_t GENERATOR_TOKENS_PER_LINE = 8;
+// Tokens past twice the shortest completion after which finishing a
+// stream is given up
+const uint64_t GENERATOR_FINISH_SLACK = 64;
+
+// Random token streams derived from the parse table of an LL1Parser, which
+// must outlive it. Each step picks a terminal the stack can take next and
+// applies the table's expansions for it exactly as ParseSession would, so
+// every derived stream is accepted, table conflicts or not. Below the
+// size target picks are random, steered towards the depth target; past it,
+// each pick is the one leaving the shortest completion.
+class TokenGenerator {
+public:
+    TokenGenerator(const LL1Parser& parser, const GeneratorOptions& options);
+    // A stream of about tokens tokens, values being the terminal names;
+    // false if no completion was found, e.g. through an unproductive
+    // nonterminal or left recursion
+    bool generate(vector<TokenRef>& stream, size_t tokens);
+    // Apply edits random deletions, insertions, replacements and swaps
+    void mutate(vector<TokenRef>& stream, size_t edits);
+    // Find a table entry the parser would expand forever with terminal as
+    // the next token, as left recursion makes it do; false if there is none
+    bool findEndlessExpansion(SymbolId& nonTerminal, SymbolId& terminal);
+
+private:
+    struct Outcome {
+        bool matched, endless;
+        size_t depth;       // stack depth after the match
+        uint64_t pending;   // shortest yield of that stack
+    };
+    void collectViable();
+    Outcome simulate(SymbolId terminal);
+    void commit();
+    uint64_t yieldLength(SymbolId symbol) const;
+
+    const LL1Parser& parser;
+    GeneratorOptions options;
+    mt19937_64 rng;
+    vector<uint64_t> minLength;     // shortest yield by nonterminal index
+    vector<SymbolId> stack;
+    vector<uint64_t> pendingBelow;  // shortest yield of stack[0..i)
+    // simulate() leaves the stack as stack[0..base) plus overlay
+    size_t base = 0;
+    vector<SymbolId> overlay;
+    vector<SymbolId> candidates;
+    vector<uint32_t> seen;          // stamp by terminal, for collectViable
+    uint32_t stamp = 0;
+};
+
+const uint64_t UNBOUNDED_LENGTH = UINT64_MAX / 4;
+
+// The shortest yields are found by iterating over the productions until
+// none gets shorter. Productions that lost every table cell to a conflict
+// are left out, since the parser never follows them.
+TokenGenerator::TokenGenerator(const LL1Parser& parser, const GeneratorOptions& options)
+    : parser(parser), options(options), rng(options.seed), seen(parser.symbols.terminalCount(), 0) {
+    vector<char> inTable(parser.grammar.size(), 0);
+    for (int n = 0; n < parser.symbols.nonTerminalCount(); ++n) {
+        for (SymbolId t = 0; t < parser.symbols.terminalCount(); ++t) {
+            ProductionIndex production = parser.parseTable.lookup(nonTerminalId(n), t);
+            if (production != NO_PRODUCTION) inTable[production] = 1;
+        }
+    }
+    minLength.assign(parser.symbols.nonTerminalCount(), UNBOUNDED_LENGTH);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t p = 0; p < parser.grammar.size(); ++p) {
+            if (!inTable[p]) continue;
+            const GrammarRule& rule = parser.grammar[p];
+            uint64_t length = 0;
+            for (SymbolId symbol : rule.rhs) length = min(UNBOUNDED_LENGTH, length + yieldLength(symbol));
+            uint64_t& known = minLength[nonTerminalIndex(rule.lhs)];
+            if (length < known) {
+                known = length;
+                changed = true;
+            }
+        }
+    }
+}
+
+uint64_t TokenGenerator::yieldLength(SymbolId symbol) const {
+    if (symbol == END_MARKER) return 0;
+    return isTerminalId(symbol) ? 1 : minLength[nonTerminalIndex(symbol)];
+}
+
+// Terminals that can start what the stack derives: FIRST of the symbols
+// from the top down to the first one that is not nullable, and "$" when
+// all of them are
+void TokenGenerator::collectViable() {
+    candidates.clear();
+    ++stamp;
+    auto add = [&](SymbolId terminal) {
+        if (seen[terminal] != stamp) {
+            seen[terminal] = stamp;
+            candidates.push_back(terminal);
+        }
+    };
+    for (size_t i = stack.size(); i-- > 0;) {
+        SymbolId symbol = stack[i];
+        if (isTerminalId(symbol)) {
+            add(symbol);
+            return;
+        }
+        parser.firstSet.forEachTerminal(parser.firstSet.row(nonTerminalIndex(symbol)), add);
+        if (!parser.firstSet.hasEpsilon(nonTerminalIndex(symbol))) return;
+    }
+}
+
+// Run the parser's expansions for terminal without touching the stack,
+// which later commit() replaces with the result. A chain of expansions
+// that ends expands each symbol already on the stack and each RHS position
+// at most once, so one longer than all of them together never ends.
+TokenGenerator::Outcome TokenGenerator::simulate(SymbolId terminal) {
+    base = stack.size();
+    overlay.clear();
+    const SymbolId* symbols = parser.pushSymbols.data();
+    size_t expansions = 0, expansionLimit = stack.size() + parser.pushSymbols.size() + 1;
+    while (true) {
+        SymbolId top = overlay.empty() ? stack[base - 1] : overlay.back();
+        if (top == terminal) break;
+        ProductionIndex production = isTerminalId(top) ? NO_PRODUCTION : parser.parseTable.lookup(top, terminal);
+        if (production == NO_PRODUCTION) return Outcome{ false, false, 0, 0 };
+        if (++expansions > expansionLimit) return Outcome{ false, true, 0, 0 };
+        if (overlay.empty()) --base;
+        else overlay.pop_back();
+        overlay.insert(overlay.end(), symbols + parser.pushStart[production], symbols + parser.pushStart[production + 1]);
+    }
+    if (terminal != END_MARKER) {
+        if (overlay.empty()) --base;
+        else overlay.pop_back();
+    }
+    uint64_t pending = pendingBelow[base];
+    for (SymbolId symbol : overlay) pending = min(UNBOUNDED_LENGTH, pending + yieldLength(symbol));
+    return Outcome{ true, false, base + overlay.size(), pending };
+}
+
+void TokenGenerator::commit() {
+    stack.resize(base);
+    pendingBelow.resize(base + 1);
+    for (SymbolId symbol : overlay) {
+        stack.push_back(symbol);
+        pendingBelow.push_back(min(UNBOUNDED_LENGTH, pendingBelow.back() + yieldLength(symbol)));
+    }
+}
+
+// Finishing takes about the shortest completion the stack had when the
+// target was reached; with table conflicts the parser may not follow the
+// shortest derivations, so up to twice that, plus some slack, is allowed
+bool TokenGenerator::generate(vector<TokenRef>& stream, size_t tokens) {
+    stream.clear();
+    stack.assign(1, END_MARKER);
+    pendingBelow.assign(2, 0);
+    if (parser.startSymbol != NO_SYMBOL) {
+        stack.push_back(parser.startSymbol);
+        pendingBelow.push_back(yieldLength(parser.startSymbol));
+    }
+    int line = 1;
+    uint64_t limit = UINT64_MAX;
+    while (true) {
+        bool finishing = stream.size() >= tokens;
+        if (finishing && limit == UINT64_MAX) {
+            if (pendingBelow.back() >= UNBOUNDED_LENGTH) return false;
+            limit = stream.size() + 2 * pendingBelow.back() + GENERATOR_FINISH_SLACK;
+        }
+        if (stream.size() > limit) return false;
+        collectViable();
+        // end the stream once it is long enough or nothing else fits
+        auto marker = find(candidates.begin(), candidates.end(), END_MARKER);
+        bool canEnd = marker != candidates.end();
+        if (canEnd) {
+            if (finishing && simulate(END_MARKER).matched) return true;
+            candidates.erase(marker);
+        }
+        size_t considered = min(candidates.size(), GENERATOR_CANDIDATES);
+        for (size_t i = 0; i < considered; ++i) swap(candidates[i], candidates[i + rng() % (candidates.size() - i)]);
+        // finishing: shortest completion; too deep: shallowest stack;
+        // otherwise now and then the deepest stack, else the first that fits
+        enum { Shortest, Shallowest, Deepest, First } goal = finishing ? Shortest
+            : stack.size() >= options.depth ? Shallowest : rng() % 4 == 0 ? Deepest : First;
+        SymbolId pick = NO_SYMBOL;
+        Outcome best = { false, false, 0, 0 };
+        for (size_t i = 0; i < considered; ++i) {
+            Outcome outcome = simulate(candidates[i]);
+            if (!outcome.matched) continue;
+            bool better = !best.matched || (goal == Shortest && outcome.pending < best.pending)
+                || (goal == Shallowest && outcome.depth < best.depth) || (goal == Deepest && outcome.depth > best.depth);
+            if (better) {
+                best = outcome;
+                pick = candidates[i];
+                if (goal == First) break;
+            }
+        }
+        if (pick == NO_SYMBOL) return canEnd && simulate(END_MARKER).matched;
+        simulate(pick);
+        commit();
+        if (rng() % GENERATOR_TOKENS_PER_LINE == 0) ++line;
+        stream.push_back(TokenRef{ line, pick, parser.symbols.name(pick) });
+    }
+}
+
+bool TokenGenerator::findEndlessExpansion(SymbolId& nonTerminal, SymbolId& terminal) {
+    for (int n = 0; n < parser.symbols.nonTerminalCount(); ++n) {
+        for (SymbolId t = 0; t < parser.symbols.terminalCount(); ++t) {
+            if (parser.parseTable.lookup(nonTerminalId(n), t) == NO_PRODUCTION) continue;
+            stack.assign(1, END_MARKER);
+            stack.push_back(nonTerminalId(n));
+            pendingBelow.assign(3, 0);
+            if (simulate(t).endless) {
+                nonTerminal = nonTerminalId(n);
+                terminal = t;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Edited tokens take the line of the token they land on, so lines stay in
+// order; a swap exchanges types and values only
+void TokenGenerator::mutate(vector<TokenRef>& stream, size_t edits) {
+    int terminals = parser.symbols.terminalCount();
+    if (terminals < 2) return;
+    for (size_t e = 0; e < edits; ++e) {
+        SymbolId type = 1 + (SymbolId)(rng() % (terminals - 1));
+        TokenRef token = { 1, type, parser.symbols.name(type) };
+        size_t at = stream.empty() ? 0 : rng() % stream.size();
+        switch (stream.empty() ? 1 : rng() % 4) {
+        case 0:
+            stream.erase(stream.begin() + at);
+            break;
+        case 1:
+            if (!stream.empty()) token.line = stream[at].line;
+            stream.insert(stream.begin() + at, token);
+            break;
+        case 2:
+            token.line = stream[at].line;
+            stream[at] = token;
+            break;
+        default:
+            if (at + 1 < stream.size()) {
+                swap(stream[at].type, stream[at + 1].type);
+                swap(stream[at].value, stream[at + 1].value);
+            }
+        }
+    }
+}
+
+// Write tokens as a text token file
+void writeTokens(ostream& out, const vector<TokenRef>& tokens, const SymbolTable& symbols) {
+    string buffer;
+    for (const TokenRef& token : tokens) {
+        ((((buffer += to_string(token.line)) += ' ') += symbols.name(token.type)) += ' ') += token.value;
+        buffer += '\n';
+        if (buffer.size() >= BATCH_WRITE_BYTES) {
+            out << buffer;
+            buffer.clear();
+        }
+    }
+    out << buffer;
+}
+
+// Write a random well-formed expression for the E/T/F grammar
+// (grammar5.txt) of about count tokens
+void writeExpressionTokens(const string& path, size_t count) {
+    mt19937 rng(12345);
+    ofstream out(path, ios::binary);
+    string buffer;
+    size_t emitted = 0;
+    int depth = 0, line = 1;
+    auto emit = [&](const char* type) {
+        buffer += to_string(line) + ' ' + type + ' ' + type + '\n';
+        ++emitted;
+        if (buffer.size() > (1 << 20)) {
+            out << buffer;
+            buffer.clear();
+        }
+    };
+    while (true) {
+        while (depth < 32 && emitted + depth + 2 < count && rng() % 4 == 0) {
+            emit("(");
+            ++depth;
+        }
+        emit("id");
+        while (depth > 0 && rng() % 3 == 0) {
+            emit(")");
+            --depth;
+        }
+        if (emitted + depth + 2 >= count) break;
+        emit(rng() % 2 ? "+" : "*");
+        if (rng() % 16 == 0) ++line;
+    }
+    while (depth-- > 0) emit(")");
+    out << buffer;
+}
+
+// Timing and allocation counts of one benchmark case
+struct BenchResult {
+    string name;
+    size_t tokens = 0;
+    double buildNs = 0, loadNs = 0, parseNs = 0;
+    double buildAllocs = 0, parseAllocs = 0;
+    bool accepted = false;
+};
+
+// Measure table construction for a grammar and parsing of one token file,
+// averaging over enough repetitions to fill minSeconds for each phase
+BenchResult benchmarkCase(const string& name, const string& grammarFile, const string& tokenFile, double minSeconds) {
+    typedef chrono::steady_clock Clock;
+    BenchResult result;
+    result.name = name;
+    auto seconds = [](Clock::time_point since) { return chrono::duration<double>(Clock::now() - since).count(); };
+
+    size_t runs = 0;
+    uint64_t allocs = allocationsSoFar();
+    Clock::time_point startTime = Clock::now();
+    do {
+        LL1Parser parser;
+        parser.loadGrammar(grammarFile);
+        parser.computeFirst();
+        parser.computeFollow();
+        parser.buildParseTable();
+        ++runs;
+    } while (seconds(startTime) < minSeconds);
+    result.buildNs = seconds(startTime) * 1e9 / runs;
+    result.buildAllocs = (double)(allocationsSoFar() - allocs) / runs;
+
+    LL1Parser parser;
+    parser.loadGrammar(grammarFile);
+    parser.computeFirst();
+    parser.computeFollow();
+    parser.buildParseTable();
+    startTime = Clock::now();
+    TokenFile tokens;
+    tokens.open(tokenFile, parser.getSymbols());
+    result.loadNs = seconds(startTime) * 1e9;
+    result.tokens = tokens.size();
+
+    ostream discard(nullptr);
+    runs = 0;
+    allocs = allocationsSoFar();
+    startTime = Clock::now();
+    do {
+        ParseSession session = parser.beginParse(discard);
+        session.feed(tokens.data(), tokens.size());
+        result.accepted = session.finish();
+        ++runs;
+    } while (seconds(startTime) < minSeconds);
+    result.parseNs = seconds(startTime) * 1e9 / runs;
+    result.parseAllocs = (double)(allocationsSoFar() - allocs) / runs;
+    return result;
+}
+
+// Same phases as benchmarkCase for an LALRParser: building covers
+// loading the grammar, its FIRST sets and the LALR(1) tables
+BenchResult benchmarkLALRCase(const string& name, const string& grammarFile, const string& tokenFile, double minSeconds) {
+    typedef chrono::steady_clock Clock;
+    BenchResult result;
+    result.name = name;
+    auto seconds = [](Clock::time_point since) { return chrono::duration<double>(Clock::now() - since).count(); };
+
+    size_t runs = 0;
+    uint64_t allocs = allocationsSoFar();
+    Clock::time_point startTime = Clock::now();
+    do {
+        LL1Parser grammar;
+        grammar.loadGrammar(grammarFile);
+        grammar.computeFirst();
+        LALRParser parser(grammar);
+        parser.build();
+        ++runs;
+    } while (seconds(startTime) < minSeconds);
+    result.buildNs = seconds(startTime) * 1e9 / runs;
+    result.buildAllocs = (double)(allocationsSoFar() - allocs) / runs;
+
+    LL1Parser grammar;
+    grammar.loadGrammar(grammarFile);
+    grammar.computeFirst();
+    LALRParser parser(grammar);
+    parser.build();
+    startTime = Clock::now();
+    TokenFile tokens;
+    tokens.open(tokenFile, grammar.getSymbols());
+    result.loadNs = seconds(startTime) * 1e9;
+    result.tokens = tokens.size();
+
+    BufferedSink discard;
+    runs = 0;
+    allocs = allocationsSoFar();
+    startTime = Clock::now();
+    do {
+        result.accepted = parser.parse(tokens.data(), tokens.size(), discard);
+        ++runs;
+    } while (seconds(startTime) < minSeconds);
+    result.parseNs = seconds(startTime) * 1e9 / runs;
+    result.parseAllocs = (double)(allocationsSoFar() - allocs) / runs;
+    return result;
+}
+
+// Debug/grammar5.txt, compiled into StaticLL1Parser for --bench
+constexpr char EXPRESSION_GRAMMAR[] =
+    "E  -> T E'\n"
+    "E' -> + T E'\n"
+    "E' -> epsilon\n"
+    "\n"
+    "T  -> F T'\n"
+    "T' -> * F T'\n"
+    "T' -> epsilon\n"
+    "\n"
+    "F  -> ( E )\n"
+    "F  -> id\n";
+
+// The same language written left-recursively, which only the LALR(1)
+// parser takes as it is; it keeps the state stack shallow
+constexpr char LEFT_RECURSIVE_EXPRESSION_GRAMMAR[] =
+    "E -> E + T\n"
+    "E -> T\n"
+    "T -> T * F\n"
+    "T -> F\n"
+    "F -> ( E )\n"
+    "F -> id\n";
+
+// A token with its type as a name, the input StaticLL1Parser expects
+struct NamedToken {
+    int line;
+    string_view type, value;
+};
+
+// Parse time of the compile-time expression parser over a token file; it
+// has no build phase, so only load and parse are filled in. grammarFile
+// supplies the token type names to TokenFile.
+BenchResult benchmarkStaticCase(const string& name, const string& grammarFile, const string& tokenFile, double minSeconds) {
+    typedef chrono::steady_clock Clock;
+    typedef StaticLL1Parser<EXPRESSION_GRAMMAR> ExpressionParser;
+    BenchResult result;
+    result.name = name;
+    auto seconds = [](Clock::time_point since) { return chrono::duration<double>(Clock::now() - since).count(); };
+
+    LL1Parser names;
+    names.loadGrammar(grammarFile);
+    Clock::time_point startTime = Clock::now();
+    TokenFile tokens;
+    tokens.open(tokenFile, names.getSymbols());
+    result.loadNs = seconds(startTime) * 1e9;
+    result.tokens = tokens.size();
+    vector<NamedToken> named;
+    named.reserve(tokens.size());
+    string_view unknown = "?";
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        const TokenRef& token = tokens.data()[i];
+        named.push_back(NamedToken{ token.line, token.type == NO_SYMBOL ? unknown : names.getSymbols().name(token.type), token.value });
+    }
+
+    ostream discard(nullptr);
+    size_t runs = 0;
+    uint64_t allocs = allocationsSoFar();
+    startTime = Clock::now();
+    do {
+        result.accepted = ExpressionParser::parse(named.data(), named.size(), discard);
+        ++runs;
+    } while (seconds(startTime) < minSeconds);
+    result.parseNs = seconds(startTime) * 1e9 / runs;
+    result.parseAllocs = (double)(allocationsSoFar() - allocs) / runs;
+    return result;
+}
+
+// Largest stream of the --bench size scaling series; sizes go up by ten
+// from 1000
+const size_t BENCH_SCALING_MAX_TOKENS = 1000000;
+
+// Benchmark the grammarN/tokensN fixtures in fixturesDir plus a generated
+// expression stream of largeTokens tokens and a size scaling series,
+// printed as one JSON document
+int runBenchmarks(const string& fixturesDir, size_t largeTokens) {
+    vector<BenchResult> results;
+    for (int i = 1; i <= 7; ++i) {
+        string grammarFile = fixturesDir + "/grammar" + to_string(i) + ".txt";
+        string tokenFile = fixturesDir + "/tokens" + to_string(i) + ".txt";
+        if (!filesystem::exists(grammarFile) || !filesystem::exists(tokenFile)) continue;
+        results.push_back(benchmarkCase("grammar" + to_string(i) + "/tokens" + to_string(i), grammarFile, tokenFile, 0.2));
+        results.push_back(benchmarkLALRCase("lalr-grammar" + to_string(i) + "/tokens" + to_string(i), grammarFile, tokenFile, 0.2));
+    }
+    ScratchDirectory scratch("ll1-bench");
+    string exprGrammar = fixturesDir + "/grammar5.txt";
+    if (largeTokens > 0 && filesystem::exists(exprGrammar)) {
+        string exprFile = scratch.file("expr.txt");
+        writeExpressionTokens(exprFile, largeTokens);
+        results.push_back(benchmarkCase("grammar5/expr" + to_string(largeTokens), exprGrammar, exprFile, 0.0));
+        results.push_back(benchmarkStaticCase("static-grammar5/expr" + to_string(largeTokens), exprGrammar, exprFile, 0.0));
+        results.push_back(benchmarkLALRCase("lalr-grammar5/expr" + to_string(largeTokens), exprGrammar, exprFile, 0.0));
+        string leftRecursiveGrammar = scratch.file("left_recursive.txt");
+        ofstream(leftRecursiveGrammar, ios::binary) << LEFT_RECURSIVE_EXPRESSION_GRAMMAR;
+        results.push_back(benchmarkLALRCase("lalr-left-recursive/expr" + to_string(largeTokens), leftRecursiveGrammar, exprFile, 0.0));
+        filesystem::remove(leftRecursiveGrammar);
+        filesystem::remove(exprFile);
+    }
+    // Throughput against input size over streams derived from the grammar,
+    // for both token file formats
+    if (largeTokens > 0 && filesystem::exists(exprGrammar)) {
+        LL1Parser parser;
+        parser.loadGrammar(exprGrammar);
+        parser.computeFirst();
+        parser.computeFollow();
+        parser.buildParseTable();
+        TokenGenerator generator(parser, GeneratorOptions());
+        vector<TokenRef> stream;
+        string textFile = scratch.file("scaling.txt");
+        string binaryFile = scratch.file("scaling.bin");
+        for (size_t size = 1000; size <= min(largeTokens, BENCH_SCALING_MAX_TOKENS); size *= 10) {
+            if (!generator.generate(stream, size)) break;
+            {
+                ofstream out(textFile, ios::binary);
+                writeTokens(out, stream, parser.getSymbols());
+            }
+            convertTokenFile(textFile, binaryFile);
+            results.push_back(benchmarkCase("scaling-grammar5/" + to_string(size), exprGrammar, textFile, 0.2));
+            results.push_back(benchmarkCase("scaling-grammar5/" + to_string(size) + ".bin", exprGrammar, binaryFile, 0.2));
+        }
+        filesystem::remove(textFile);
+        filesystem::remove(binaryFile);
+    }
+
+    // Allocation counts are null unless the build counts them
+    auto allocations = [](double count) {
+        ostringstream text;
+        if (COUNTS_ALLOCATIONS) text << count;
+        else text << "null";
+        return text.str();
+    };
+    cout << "{\"version\": 1, \"cases\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        cout << (i ? ",\n" : "\n") << "  {\"case\": \"" << r.name << "\", \"tokens\": " << r.tokens
+             << ", \"build_ns\": " << (uint64_t)r.buildNs << ", \"build_allocs\": " << allocations(r.buildAllocs)
+             << ", \"load_ns\": " << (uint64_t)r.loadNs << ", \"parse_ns\": " << (uint64_t)r.parseNs
+             << ", \"ns_per_token\": " << (r.tokens ? r.parseNs / r.tokens : 0.0)
+             << ", \"parse_allocs\": " << allocations(r.parseAllocs) << ", \"accepted\": " << (r.accepted ? "true" : "false") << "}";
+    }
+    cout << "\n], \"peak_rss_kb\": " << peakRssKb() << "}" << endl;
+    return 0;
+}
+
+// Print build and parse statistics as JSON for --stats
+void writeStatsJson(ostream& out, const BuildStats& build, const ParseStats& parse, uint64_t tokens, uint64_t loadTokensNs, uint64_t parseNs) {
+    out << "{\"load_grammar_ns\": " << build.loadGrammarNs << ", \"rewrite_grammar_ns\": " << build.rewriteGrammarNs
+        << ", \"reduce_grammar_ns\": " << build.reduceGrammarNs
+        << ", \"compute_first_ns\": " << build.computeFirstNs
+        << ", \"compute_follow_ns\": " << build.computeFollowNs << ", \"build_parse_table_ns\": " << build.buildParseTableNs
+        << ", \"load_tables_ns\": " << build.loadTablesNs << ", \"first_iterations\": " << build.firstIterations
+        << ", \"follow_iterations\": " << build.followIterations << ", \"tokens\": " << tokens
+        << ", \"load_tokens_ns\": " << loadTokensNs << ", \"parse_ns\": " << parseNs
+        << ", \"expansions\": " << parse.expansions << ", \"matches\": " << parse.matches
+        << ", \"max_stack_depth\": " << parse.maxStackDepth << ", \"errors\": " << parse.errors << "}" << endl;
+}
+
+// One line per nonterminal --rewrite changed or added, on stderr
+void writeRewrite(ostream& out, const GrammarRewrite& rewrite) {
+    for (const string& name : rewrite.leftRecursive) out << "Removed left recursion of " << name << '\n';
+    for (const string& name : rewrite.leftFactored) out << "Left-factored " << name << '\n';
+    for (const string& name : rewrite.added) out << "Added nonterminal " << name << '\n';
+}
+
+// One line per symbol --reduce removed, on stderr like the conflicts
+void writeReduction(ostream& out, const GrammarReduction& reduction) {
+    for (const string& name : reduction.unproductive) out << "Removed unproductive nonterminal " << name << '\n';
+    for (const string& name : reduction.unreachable) out << "Removed unreachable nonterminal " << name << '\n';
+    for (const string& name : reduction.terminals) out << "Removed unused terminal " << name << '\n';
+    if (reduction.productions > 0) out << "Removed " << reduction.productions << (reduction.productions == 1 ? " production" : " productions") << '\n';
+}
+
+// Print a parse tree for --tree, one node per line indented by depth;
+// terminals show the matched token's value
+void writeParseTree(ostream& out, const ParseTree& tree, const SymbolTable& symbols, const TokenRef* tokens) {
+    string text;
+    vector<pair<uint32_t, uint32_t>> pending;   // node, depth
+    if (!tree.nodes.empty()) pending.push_back({ 0, 0 });
+    while (!pending.empty()) {
+        uint32_t index = pending.back().first, depth = pending.back().second;
+        pending.pop_back();
+        const ParseNode& node = tree.nodes[index];
+        text.append(depth * 2, ' ');
+        text += symbols.name(node.symbol);
+        if (isTerminalId(node.symbol) && node.tokenCount == 1) {
+            text += ' ';
+            text += tokens[node.firstToken].value;
+        }
+        else if (node.production != NO_PRODUCTION && node.childCount == 0) {
+            text += " epsilon";
+        }
+        text += '\n';
+        for (uint32_t i = node.childCount; i-- > 0;) pending.push_back({ node.firstChild + i, depth + 1 });
+        if (text.size() > (1 << 20)) {
+            out << text;
+            text.clear();
+        }
+    }
+    out << text;
+}
+
+// Write the generated parser for --emit-parser. Its namespace is the file
+// name without extension, made into an identifier.
+int emitParser(const LL1Parser& parser, const string& path) {
+    string name = filesystem::path(path).stem().string();
+    for (char& c : name) {
+        if (!isalnum((unsigned char)c)) c = '_';
+    }
+    if (name.empty() || isdigit((unsigned char)name[0])) name.insert(0, "ll1_");
+    ofstream out(path, ios::binary);
+    parser.writeRecursiveDescent(out, name);
+    if (!out) {
+        cerr << "Cannot write " << path << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Write a stream derived from the grammar for --generate, as a text token
+// file and, when binaryPath is given, also in the binary format
+int runGenerate(const LL1Parser& parser, const GeneratorOptions& options, size_t tokens, size_t edits, const string& textPath, const string& binaryPath) {
+    TokenGenerator generator(parser, options);
+    vector<TokenRef> stream;
+    if (!generator.generate(stream, tokens)) {
+        cerr << "could not derive a complete token stream from the grammar" << endl;
+        return 1;
+    }
+    generator.mutate(stream, edits);
+    {
+        ofstream out(textPath, ios::binary);
+        writeTokens(out, stream, parser.getSymbols());
+        if (!out) {
+            cerr << "cannot write " << textPath << endl;
+            return 1;
+        }
+    }
+    if (!binaryPath.empty() && !convertTokenFile(textPath, binaryPath)) {
+        cerr << "cannot write " << binaryPath << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Result and reports of a ParseSession over a token file
+static bool parseTokenFile(const LL1Parser& parser, const string& path, BufferedSink& errors, ParseStats& stats) {
+    TokenFile tokens;
+    tokens.open(path, parser.getSymbols());
+    errors.clear();
+    ParseSession session = parser.beginParse(errors);
+    session.feed(tokens.data(), tokens.size());
+    bool accepted = session.finish();
+    stats = session.getStats();
+    return accepted;
+}
+
+// --fuzz: derive cases streams of up to tokens tokens and a mutated copy of
+// each. Every derived stream must be accepted; both streams must give the
+// same result and errors from their text and binary token files; and when
+// neither the LL(1) nor the LALR(1) table has conflicts, the LALR(1) parser
+// must agree on acceptance. Failures are listed on stderr with their case.
+int runFuzz(const LL1Parser& parser, const GeneratorOptions& options, size_t cases, size_t tokens) {
+    TokenGenerator generator(parser, options);
+    SymbolId endlessTop, endlessTerminal;
+    if (generator.findEndlessExpansion(endlessTop, endlessTerminal)) {
+        cerr << "fuzz: the parse table expands " << parser.getSymbols().name(endlessTop) << " on '" << parser.getSymbols().name(endlessTerminal)
+             << "' forever (left recursion, see --rewrite)" << endl;
+        return 1;
+    }
+    LALRParser lalr(parser);
+    lalr.build();
+    bool compareLALR = parser.getConflicts().empty() && lalr.getConflicts().empty();
+    ScratchDirectory scratch("ll1-fuzz");
+    string textPath = scratch.file("tokens.txt"), binaryPath = scratch.file("tokens.bin");
+    mt19937_64 rng(options.seed);
+    size_t failures = 0, rejected = 0, stuck = 0, maxDepth = 0;
+    vector<TokenRef> stream;
+    BufferedSink textErrors, binaryErrors, lalrErrors;
+    auto fail = [&](size_t c, const char* stage, const string& what) {
+        ++failures;
+        cerr << "fuzz case " << c << " (" << stage << "): " << what << endl;
+    };
+    for (size_t c = 0; c < cases; ++c) {
+        if (!generator.generate(stream, (size_t)(rng() % (tokens + 1)))) {
+            ++stuck;
+            continue;
+        }
+        for (int mutated = 0; mutated < 2; ++mutated) {
+            const char* stage = mutated ? "mutated" : "derived";
+            if (mutated) generator.mutate(stream, 1 + rng() % 3);
+            {
+                ofstream out(textPath, ios::binary);
+                writeTokens(out, stream, parser.getSymbols());
+            }
+            if (!convertTokenFile(textPath, binaryPath)) {
+                fail(c, stage, "cannot write the binary token file");
+                continue;
+            }
+            ParseStats textStats, binaryStats;
+            bool accepted = parseTokenFile(parser, textPath, textErrors, textStats);
+            bool binaryAccepted = parseTokenFile(parser, binaryPath, binaryErrors, binaryStats);
+            maxDepth = max(maxDepth, textStats.maxStackDepth);
+            if (!mutated && !accepted) fail(c, stage, "rejected: " + textErrors.text());
+            if (mutated && !accepted) ++rejected;
+            if (accepted != binaryAccepted || textErrors.text() != binaryErrors.text()) fail(c, stage, "text and binary token files differ");
+            if (compareLALR && lalr.parse(stream.data(), stream.size(), lalrErrors) != accepted) fail(c, stage, "the LALR(1) parser disagrees");
+        }
+    }
+    cerr << "fuzz: " << cases << " cases, " << stuck << " not derived, " << rejected << " mutated streams rejected, max stack depth "
+         << maxDepth << (compareLALR ? ", checked against LALR(1)" : "") << ", " << failures << (failures == 1 ? " failure" : " failures") << endl;
+    return failures > 0 ? 1 : 0;
+}
+
+// FIRST and FOLLOW sets, table cells and conflicts of a built parser as
+// sorted lines that name every symbol, so parsers whose symbols were
+// interned in a different order can be compared. Empty sets and cells are
+// left out.
+string describeAnalysis(const LL1Parser& parser) {
+    const SymbolTable& symbols = parser.symbols;
+    vector<string> lines;
+    auto describeSet = [&](const char* kind, const TerminalSets& sets, int n) {
+        vector<string> names;
+        sets.forEachTerminal(sets.row(n), [&](SymbolId t) { names.push_back(string(symbols.name(t))); });
+        if (sets.hasEpsilon(n)) names.push_back("epsilon");
+        if (names.empty()) return;
+        sort(names.begin(), names.end());
+        string line = string(kind) + ' ' + string(symbols.name(nonTerminalId(n))) + ':';
+        for (const string& name : names) (line += ' ') += name;
+        lines.push_back(line);
+    };
+    for (int n = 0; n < symbols.nonTerminalCount(); ++n) {
+        describeSet("FIRST", parser.firstSet, n);
+        describeSet("FOLLOW", parser.followSet, n);
+        for (SymbolId t = 0; t < symbols.terminalCount(); ++t) {
+            ProductionIndex production = parser.parseTable.lookup(nonTerminalId(n), t);
+            if (production == NO_PRODUCTION) continue;
+            lines.push_back("TABLE " + string(symbols.name(nonTerminalId(n))) + ' ' + string(symbols.name(t)) + ": " + parser.productionText(production));
+        }
+    }
+    ostringstream conflicts;
+    parser.writeConflicts(conflicts);
+    istringstream conflictLines(conflicts.str());
+    for (string line; getline(conflictLines, line);) lines.push_back(line);
+    sort(lines.begin(), lines.end());
+    string text;
+    for (const string& line : lines) (text += line) += '\n';
+    return text;
+}
+
+// Rounds of each --self-test check
+const size_t SELF_TEST_ROUNDS = 200;
+// A --self-test check stops after this many failing rounds
+const size_t SELF_TEST_FAILURE_LIMIT = 4;
+// Edits applied to each random grammar of --self-test edits
+const size_t SELF_TEST_EDITS = 12;
+
+// --self-test edits: build a random grammar, then add and remove random
+// productions one at a time, and after every edit compare the parser with
+// one built from scratch for the edited grammar. Half of the rounds edit
+// tables loaded from a table file. The first production is never removed,
+// so both parsers keep the same start symbol.
+int runEditSelfTest(uint64_t seed) {
+    typedef pair<string, vector<string>> Production;
+    static const char* const GRAMMAR_NAMES[] = { "S", "A", "B", "C", "D", "a", "b", "c", "d" };
+    static const char* const EDIT_NAMES[] = { "S", "A", "B", "C", "D", "E", "a", "b", "c", "d", "f" };
+    ScratchDirectory scratch("ll1-self-test");
+    string grammarPath = scratch.file("grammar.txt"), tablePath = scratch.file("tables.bin");
+    mt19937_64 rng(seed);
+    auto writeGrammar = [&](const vector<Production>& productions) {
+        ofstream out(grammarPath, ios::binary);
+        for (const Production& production : productions) {
+            out << production.first << " ->";
+            for (const string& name : production.second) out << ' ' << name;
+            out << (production.second.empty() ? " epsilon\n" : "\n");
+        }
+    };
+    auto build = [&](LL1Parser& parser) {
+        parser.loadGrammar(grammarPath);
+        parser.computeFirst();
+        parser.computeFollow();
+        parser.buildParseTable();
+    };
+    auto randomBody = [&](const char* const* names, size_t count) {
+        vector<string> body(rng() % 4);
+        for (string& name : body) name = names[rng() % count];
+        return body;
+    };
+    size_t failures = 0, edits = 0, round = 0;
+    for (; round < SELF_TEST_ROUNDS && failures < SELF_TEST_FAILURE_LIMIT; ++round) {
+        vector<Production> productions;
+        size_t nonTerminals = 1 + rng() % 5;
+        for (size_t n = 0; n < nonTerminals; ++n) {
+            for (size_t k = 1 + rng() % 3; k > 0; --k) productions.push_back(Production(GRAMMAR_NAMES[n], randomBody(GRAMMAR_NAMES, size(GRAMMAR_NAMES))));
+        }
+        writeGrammar(productions);
+        unique_ptr<LL1Parser> edited = make_unique<LL1Parser>();
+        build(*edited);
+        if (round % 2) {
+            edited->saveTables(tablePath, round);
+            edited = make_unique<LL1Parser>();
+            if (!edited->loadTables(tablePath, round)) {
+                cerr << "self-test edits round " << round << ": cannot load the table file" << endl;
+                ++failures;
+                continue;
+            }
+        }
+        string history;
+        for (size_t e = 0; e < SELF_TEST_EDITS; ++e) {
+            Production production;
+            bool adding = productions.size() < 2 || rng() % 5 < 3;
+            if (adding) {
+                production.first = EDIT_NAMES[rng() % 6];
+                production.second = randomBody(EDIT_NAMES, size(EDIT_NAMES));
+                edited->addProduction(production.first, production.second);
+                productions.push_back(production);
+            }
+            else {
+                // removeProduction takes the last production equal to the one named
+                size_t i = 1 + rng() % (productions.size() - 1);
+                production = productions[i];
+                for (size_t j = productions.size(); j-- > i;) {
+                    if (productions[j] == production) {
+                        productions.erase(productions.begin() + j);
+                        break;
+                    }
+                }
+                edited->removeProduction(production.first, production.second);
+            }
+            ++edits;
+            history += adding ? "  add " : "  remove ";
+            history += production.first + " ->";
+            for (const string& name : production.second) (history += ' ') += name;
+            history += '\n';
+            writeGrammar(productions);
+            LL1Parser rebuilt;
+            build(rebuilt);
+            string expected = describeAnalysis(rebuilt), actual = describeAnalysis(*edited);
+            if (actual == expected) continue;
+            ++failures;
+            cerr << "self-test edits round " << round << (round % 2 ? " (loaded tables)" : "") << ": edits differ from a full build after\n"
+                 << history << "full build:\n" << expected << "edited:\n" << actual;
+            break;
+        }
+    }
+    cerr << "self-test edits: " << round << " grammars, " << edits << " edits, " << failures
+         << (failures == 1 ? " failure" : " failures") << endl;
+    return failures > 0 ? 1 : 0;
+}
+
+// Text with control bytes spelled out, for self-test reports
+static string escapedText(string_view text) {
+    static const char HEX[] = "0123456789abcdef";
+    string out;
+    for (char c : text) {
+        unsigned char byte = (unsigned char)c;
+        if (byte >= ' ' && byte < 0x7F && c != '\\') out += c;
+        else if (c == '\n') out += "\\n\n";
+        else ((out += "\\x") += HEX[byte >> 4]) += HEX[byte & 15];
+    }
+    return out;
+}
+
+// --self-test scanner: compare the token file scanner with byte-at-a-time
+// references on random records of numbers, words with NUL, high bytes and
+// the bytes just above '9', and runs of every separator. Each block is classified by every path the
+// build compiled (AVX2, SSE2, scalar); whole texts go through
+// splitTokenRecords, and so through parseLineNumber, against a plain
+// splitter; and NameHash tables over random names with shared prefixes
+// and suffixes must find every name and nothing else.
+int runScannerSelfTest(uint64_t seed) {
+    static const char SEPARATORS[] = " \t\r\v\f";
+    static const char WORD_BYTES[] = "abAB_'+-9:?\0\x80\xff";
+    typedef tuple<int, string, string> Record;
+    mt19937_64 rng(seed);
+    size_t failures = 0, blocks = 0, tables = 0, unplaced = 0, round = 0;
+    auto fail = [&](size_t r, const string& what, string_view text) {
+        ++failures;
+        cerr << "self-test scanner round " << r << ": " << what << " for\n" << escapedText(text) << endl;
+    };
+    auto isSeparator = [](char c) { return c == ' ' || (c >= '\t' && c <= '\r'); };
+    for (; round < SELF_TEST_ROUNDS && failures < SELF_TEST_FAILURE_LIMIT; ++round) {
+        string text;
+        for (size_t lines = rng() % 12; lines > 0; --lines) {
+            for (size_t fields = rng() % 5; fields > 0; --fields) {
+                for (size_t n = rng() % 4; n > 0; --n) text += SEPARATORS[rng() % 5];
+                if (rng() % 2) {
+                    if (rng() % 4 == 0) text += '-';
+                    size_t limit = rng() % 8 ? 9 : 12;
+                    for (size_t n = 1 + rng() % limit; n > 0; --n) text += (char)('0' + rng() % 10);
+                    if (rng() % 4 == 0) text += WORD_BYTES[rng() % (sizeof(WORD_BYTES) - 1)];
+                }
+                else {
+                    size_t limit = rng() % 8 ? 10 : 80;
+                    for (size_t n = 1 + rng() % limit; n > 0; --n) text += WORD_BYTES[rng() % (sizeof(WORD_BYTES) - 1)];
+                }
+            }
+            for (size_t n = rng() % 3; n > 0; --n) text += SEPARATORS[rng() % 5];
+            if (lines > 1 || rng() % 2) text += '\n';
+        }
+        // An exact-size copy, so reads past the end are caught by sanitizers
+        unique_ptr<char[]> data(new char[text.size() + 1]);
+        memcpy(data.get(), text.data(), text.size());
+
+        for (size_t base = 0; base <= text.size(); base += 64) {
+            char padded[64];
+            memset(padded, '\n', sizeof(padded));
+            memcpy(padded, text.data() + base, min<size_t>(64, text.size() - base));
+            SeparatorBlock expected, block(data.get(), text.size(), base);
+            for (int i = 0; i < 64; ++i) {
+                if (padded[i] == '\n') expected.newlines |= uint64_t(1) << i;
+                else if (isSeparator(padded[i])) expected.spaces |= uint64_t(1) << i;
+            }
+            vector<pair<const char*, SeparatorBlock>> paths;
+            paths.push_back(make_pair("constructor", block));
+#if defined(TOKEN_SCAN_AVX2)
+            paths.push_back(make_pair("AVX2", SeparatorBlock()));
+            paths.back().second.classifyAVX2(padded);
+#endif
+#if defined(TOKEN_SCAN_SSE2)
+            paths.push_back(make_pair("SSE2", SeparatorBlock()));
+            paths.back().second.classifySSE2(padded);
+#endif
+            paths.push_back(make_pair("scalar", SeparatorBlock()));
+            paths.back().second.classifyScalar(padded);
+            for (const auto& path : paths) {
+                if (path.second.spaces != expected.spaces || path.second.newlines != expected.newlines) {
+                    fail(round, string("the ") + path.first + " classifier is wrong at block " + to_string(base / 64), text);
+                }
+            }
+            ++blocks;
+        }
+
+        vector<Record> expected, actual;
+        for (size_t lineStart = 0; lineStart < text.size();) {
+            size_t lineEnd = text.find('\n', lineStart);
+            if (lineEnd == string::npos) lineEnd = text.size();
+            vector<string> fields;
+            for (size_t i = lineStart; i < lineEnd;) {
+                if (isSeparator(text[i])) {
+                    ++i;
+                    continue;
+                }
+                size_t start = i;
+                while (i < lineEnd && !isSeparator(text[i])) ++i;
+                fields.push_back(text.substr(start, i - start));
+            }
+            if (fields.size() >= 2) {
+                const string& number = fields[0];
+                bool negative = number[0] == '-';
+                unsigned line = 0;
+                for (size_t i = negative; i < number.size() && number[i] >= '0' && number[i] <= '9'; ++i) line = line * 10 + (unsigned)(number[i] - '0');
+                expected.push_back(Record((int)(negative ? 0u - line : line), fields[1], fields.size() > 2 ? fields[2] : string()));
+            }
+            lineStart = lineEnd + 1;
+        }
+        splitTokenRecords(data.get(), text.size(), [&](int line, string_view type, string_view value) {
+            actual.push_back(Record(line, string(type), string(value)));
+        });
+        if (actual != expected) fail(round, "splitTokenRecords gives " + to_string(actual.size()) + " records, expected " + to_string(expected.size()), text);
+        else {
+            TokenFile tokens;
+            SymbolTable symbols;
+            tokens.assign(text, symbols);
+            vector<Record> assigned;
+            for (size_t i = 0; i < tokens.size(); ++i) assigned.push_back(Record(tokens.data()[i].line, string(symbols.name(0)), string(tokens.data()[i].value)));
+            for (Record& record : expected) get<1>(record) = string(symbols.name(0));
+            if (assigned != expected) fail(round, "TokenFile::assign differs from splitTokenRecords", text);
+        }
+
+        vector<string> storage;
+        unordered_set<string> distinct;
+        for (size_t n = rng() % 200; n > 0; --n) {
+            string name;
+            size_t limit = rng() % 4 ? 12 : 40;
+            for (size_t length = rng() % limit; length > 0; --length) name += WORD_BYTES[rng() % 4];
+            if (rng() % 3 == 0) name = storage.empty() ? name : storage[rng() % storage.size()] + name;
+            if (distinct.insert(name).second) storage.push_back(name);
+        }
+        vector<pair<string_view, SymbolId>> names;
+        for (size_t i = 0; i < storage.size(); ++i) names.push_back(make_pair(string_view(storage[i]), (SymbolId)i));
+        NameHash hash;
+        bool built = hash.build(names);
+        ++tables;
+        unplaced += !built;
+        for (const auto& name : names) {
+            if (hash.find(name.first) != (built ? name.second : NO_SYMBOL)) {
+                fail(round, "NameHash misses " + to_string(name.second) + " of " + to_string(names.size()) + " names", name.first);
+                break;
+            }
+        }
+        for (size_t probes = 4 * names.size() + 4; probes > 0; --probes) {
+            string name;
+            for (size_t length = rng() % 16; length > 0; --length) name += WORD_BYTES[rng() % 4];
+            if (!distinct.count(name) && hash.find(name) != NO_SYMBOL) {
+                fail(round, "NameHash finds a name it was not built with", name);
+                break;
+            }
+        }
+    }
+    cerr << "self-test scanner: " << round << " texts, " << blocks << " blocks checked on the "
+#if defined(TOKEN_SCAN_AVX2)
+         << "AVX2, SSE2 and scalar paths, "
+#elif defined(TOKEN_SCAN_SSE2)
+         << "SSE2 and scalar paths, "
+#else
+         << "scalar path, "
+#endif
+         << tables << " name hashes (" << unplaced << " unplaced), " << failures << (failures == 1 ? " failure" : " failures") << endl;
+    return failures > 0 ? 1 : 0;
+}
+
+// Lines of the fixed first --self-test tokens stream: deltas on both
+// sides of the int16 limits, jumps far past them in both directions,
+// negative lines and the ends of the int range
+const int SELF_TEST_EDGE_LINES[] = { 1, 32768, 32768, 0, -32768, 0, 32767, 65534, 32766, 1, 40000, 7, -3, -40000, 100000,
+    67233, INT_MAX, INT_MIN, -1, INT_MAX, INT_MAX - 32767, 2 };
+
+// --self-test tokens: write token files, convert each with
+// convertTokenFile, and check that the binary file gives the same
+// TokenRefs as the text one, that both give the same parse of the
+// expression grammar with every error reported, and that the binary file
+// holds one LINE_RECORD for each line change outside the int16 delta. The
+// first stream is the SELF_TEST_EDGE_LINES one; the rest mix small
+// steps, edge deltas and large jumps with unknown types and empty values.
+int runTokenFileSelfTest(uint64_t seed) {
+    static const char* const TYPES[] = { "id", "+", "*", "(", ")", "zz" };
+    static const char* const VALUES[] = { "", "x", "y1", "a-longer-value", "x" };
+    ScratchDirectory scratch("ll1-self-test");
+    string grammarPath = scratch.file("grammar.txt"), textPath = scratch.file("tokens.txt"), binaryPath = scratch.file("tokens.bin");
+    ofstream(grammarPath, ios::binary) << EXPRESSION_GRAMMAR;
+    LL1Parser parser;
+    parser.setErrorLimit(0);
+    parser.loadGrammar(grammarPath);
+    parser.computeFirst();
+    parser.computeFollow();
+    parser.buildParseTable();
+    mt19937_64 rng(seed);
+    size_t failures = 0, tokenCount = 0, escapes = 0, round = 0;
+    auto fail = [&](size_t r, const string& what) {
+        ++failures;
+        cerr << "self-test tokens round " << r << ": " << what << endl;
+    };
+    for (; round < SELF_TEST_ROUNDS && failures < SELF_TEST_FAILURE_LIMIT; ++round) {
+        vector<int> lines;
+        if (round == 0) lines.assign(begin(SELF_TEST_EDGE_LINES), end(SELF_TEST_EDGE_LINES));
+        for (size_t n = round == 0 ? 0 : rng() % 64; n > 0; --n) {
+            int64_t line = lines.empty() ? 1 : lines.back();
+            switch (rng() % 6) {
+            case 0: line += (int64_t)(rng() % 65536) - 32768; break;
+            case 1: line += rng() % 2 ? 32767 + (int64_t)(rng() % 3) : -32768 - (int64_t)(rng() % 3); break;
+            case 2: line = (int64_t)(rng() % UINT32_MAX) + INT_MIN; break;
+            default: line += rng() % 3; break;
+            }
+            lines.push_back((int)max<int64_t>(INT_MIN, min<int64_t>(INT_MAX, line)));
+        }
+        size_t expectedEscapes = 0;
+        {
+            ofstream out(textPath, ios::binary);
+            int64_t previous = 0;
+            for (int line : lines) {
+                const char* value = VALUES[rng() % size(VALUES)];
+                out << line << (rng() % 2 ? " " : "\t") << TYPES[rng() % size(TYPES)] << (*value ? " " : "") << value << '\n';
+                expectedEscapes += line - previous < INT16_MIN || line - previous > INT16_MAX;
+                previous = line;
+            }
+        }
+        if (!convertTokenFile(textPath, binaryPath)) {
+            fail(round, "convertTokenFile fails");
+            continue;
+        }
+        TokenFile text, binary;
+        if (!text.open(textPath, parser.getSymbols()) || !binary.open(binaryPath, parser.getSymbols())) {
+            fail(round, "cannot open a token file");
+            continue;
+        }
+        TokenFileHeader header;
+        {
+            ifstream in(binaryPath, ios::binary);
+            in.read((char*)&header, sizeof(header));
+        }
+        tokenCount += lines.size();
+        escapes += header.recordCount - header.tokenCount;
+        if (header.tokenCount != lines.size() || header.recordCount - header.tokenCount != expectedEscapes) {
+            fail(round, to_string(header.recordCount - header.tokenCount) + " line records for " + to_string(expectedEscapes) + " line changes outside int16");
+            continue;
+        }
+        bool same = text.size() == lines.size() && binary.size() == lines.size();
+        for (size_t i = 0; same && i < lines.size(); ++i) {
+            const TokenRef &a = text.data()[i], &b = binary.data()[i];
+            same = a.line == lines[i] && b.line == a.line && b.type == a.type && b.value == a.value;
+            if (!same) fail(round, "token " + to_string(i) + " differs: line " + to_string(lines[i]) + " read as " + to_string(a.line) + " from text and " + to_string(b.line) + " from binary");
+        }
+        if (!same) continue;
+        BufferedSink textErrors, binaryErrors;
+        ParseSession textSession = parser.beginParse(textErrors);
+        textSession.feed(text.data(), text.size());
+        bool textAccepted = textSession.finish();
+        ParseSession binarySession = parser.beginParse(binaryErrors);
+        binarySession.feed(binary.data(), binary.size());
+        if (binarySession.finish() != textAccepted || binaryErrors.text() != textErrors.text()) fail(round, "the parses of the text and binary files differ");
+    }
+    cerr << "self-test tokens: " << round << " token files, " << tokenCount << " tokens, " << escapes << " line records, " << failures
+         << (failures == 1 ? " failure" : " failures") << endl;
+    return failures > 0 ? 1 : 0;
+}
+
+// Run the --self-test check called name
+int runSelfTest(const string& name, uint64_t seed) {
+    if (name == "edits") return runEditSelfTest(seed);
+    if (name == "scanner") return runScannerSelfTest(seed);
+    if (name == "tokens") return runTokenFileSelfTest(seed);
+    cerr << "unknown self-test " << name << "; one of: edits, scanner, tokens" << endl;
+    return 1;
+}
+
+// Parse one token file with an LALRParser for --lalr. Its conflicts go to
+// stderr like the LL(1) ones, and --strict makes them fatal.
+int runLALR(const LL1Parser& parser, const string& tokenFile, const string& errorFile, bool strict, bool printStats) {
+    LALRParser lalr(parser);
+    lalr.setStrict(strict);
+    uint64_t buildNs = 0, loadTokensNs = 0, parseNs = 0;
+    try {
+        PhaseTimer timer(buildNs);
+        lalr.build();
+    }
+    catch (const exception& e) {
+        lalr.writeConflicts(cerr);
+        cerr << e.what() << endl;
+        return 1;
+    }
+    lalr.writeConflicts(cerr);
+    TokenFile tokens;
+    {
+        PhaseTimer timer(loadTokensNs);
+        tokens.open(tokenFile, parser.getSymbols());
+    }
+    bool accepted;
+    {
+        PhaseTimer timer(parseNs);
+        LazyFileSink errors(errorFile);
+        accepted = lalr.parse(tokens.data(), tokens.size(), errors);
+    }
+    cout << (accepted ? "YES\n" : "NO\n");
+    if (printStats) {
+        cerr << "{\"load_grammar_ns\": " << parser.getStats().loadGrammarNs << ", \"compute_first_ns\": " << parser.getStats().computeFirstNs
+             << ", \"build_lalr_ns\": " << buildNs << ", \"states\": " << lalr.stateCount() << ", \"table_bytes\": " << lalr.memoryUsage()
+             << ", \"tokens\": " << tokens.size() << ", \"load_tokens_ns\": " << loadTokensNs << ", \"parse_ns\": " << parseNs << "}" << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    string cacheFile, treeFile, emitFile, traceFile;
+    size_t traceLast = TRACE_HISTORY_STEPS;
+    bool traceErrors = false;
+    bool batch = false, printStats = false, ebnf = false, strict = false, convertTokens = false, serve = false, reduce = false, rewrite = false, lalr = false, generate = false;
+    GeneratorOptions generatorOptions;
+    size_t generateTokens = 1000, generateEdits = 0, fuzzCases = 0;
+    string selfTest;
+    int jobs = 0;
+    ServeOptions serveOptions;
+    string syncTerminal, syncRestart;
+    size_t maxErrors = 1;
+    string benchDir;
+    size_t benchTokens = 10000000;
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--cache" && i + 1 < argc) cacheFile = argv[++i];
+        else if (arg == "--batch") batch = true;
+        else if (arg == "--tree" && i + 1 < argc) treeFile = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc) traceFile = argv[++i];
+        else if (arg == "--trace-last" && i + 1 < argc) {
+            traceLast = strtoull(argv[++i], nullptr, 10);
+            traceErrors = true;
+        }
+        else if (arg == "--emit-parser" && i + 1 < argc) emitFile = argv[++i];
+        else if (arg == "--convert-tokens") convertTokens = true;
+        else if (arg == "--serve") serve = true;
+        else if (arg == "--sync" && i + 2 < argc) {
+            syncTerminal = argv[++i];
+            syncRestart = argv[++i];
+        }
+        else if (arg == "--cache-bytes" && i + 1 < argc) serveOptions.cacheBytes = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--stats") printStats = true;
+        else if (arg == "--ebnf") ebnf = true;
+        else if (arg == "--strict") strict = true;
+        else if (arg == "--reduce") reduce = true;
+        else if (arg == "--rewrite") rewrite = true;
+        else if (arg == "--lalr") lalr = true;
+        else if (arg == "--generate") generate = true;
+        else if (arg == "--fuzz" && i + 1 < argc) fuzzCases = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--gen-tokens" && i + 1 < argc) generateTokens = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--gen-depth" && i + 1 < argc) generatorOptions.depth = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--gen-mutations" && i + 1 < argc) generateEdits = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--self-test" && i + 1 < argc) selfTest = argv[++i];
+        else if (arg == "--seed" && i + 1 < argc) generatorOptions.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--jobs" && i + 1 < argc) jobs = atoi(argv[++i]);
+        else if (arg == "--max-errors" && i + 1 < argc) maxErrors = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--bench") benchDir = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : ".";
+        else if (arg == "--bench-tokens" && i + 1 < argc) benchTokens = strtoull(argv[++i], nullptr, 10);
+        else args.push_back(arg);
+    }
+    if (!benchDir.empty()) return runBenchmarks(benchDir, benchTokens);
+    if (!selfTest.empty()) return runSelfTest(selfTest, generatorOptions.seed);
+    if (serve) {
+        serveOptions.ebnf = ebnf;
+        serveOptions.strict = strict;
+        serveOptions.reduce = reduce;
+        serveOptions.rewrite = rewrite;
+        serveOptions.maxErrors = maxErrors;
+        serveOptions.jobs = jobs;
+        return runServer(serveOptions, printStats);
+    }
+    if (convertTokens && args.size() >= 2) return convertTokenFile(args[0], args[1]) ? 0 : 1;
+    size_t needed = !emitFile.empty() || fuzzCases > 0 ? 1 : generate ? 2 : 3;
+    if (args.size() < needed || convertTokens) {
+        cerr << "usage: Demo_02 [--cache tables.bin] [--stats] [--ebnf] [--strict] [--rewrite] [--reduce] [--jobs N] [--tree tree.txt] [--max-errors N] [--trace trace.txt] [--trace-last N] grammar.txt tokens.txt errors.txt" << endl;
+        cerr << "       Demo_02 [options] --sync terminal \"restart symbols\" --jobs N grammar.txt tokens.txt errors.txt" << endl;
+        cerr << "       Demo_02 --lalr [--stats] [--ebnf] [--strict] [--rewrite] [--reduce] grammar.txt tokens.txt errors.txt" << endl;
+        cerr << "       Demo_02 --batch [--jobs N] [--cache tables.bin] [--max-errors N] grammar.txt <list.txt|dir> errors.txt" << endl;
+        cerr << "       Demo_02 --bench [fixtures-dir] [--bench-tokens N]" << endl;
+        cerr << "       Demo_02 [--ebnf] [--strict] [--rewrite] [--reduce] --emit-parser parser.cpp grammar.txt" << endl;
+        cerr << "       Demo_02 --convert-tokens tokens.txt tokens.bin" << endl;
+        cerr << "       Demo_02 [options] --generate [--gen-tokens N] [--gen-depth N] [--gen-mutations N] [--seed N] grammar.txt tokens.txt [tokens.bin]" << endl;
+        cerr << "       Demo_02 [options] --fuzz N [--gen-tokens N] [--gen-depth N] [--seed N] [--max-errors N] grammar.txt" << endl;
+        cerr << "       Demo_02 --self-test edits|scanner|tokens [--seed N]" << endl;
+        cerr << "       Demo_02 --serve [--jobs N] [--cache-bytes N] [--ebnf] [--strict] [--rewrite] [--reduce] [--max-errors N] [--stats] < requests" << endl;
+        return 1;
+    }
+
+    // With --cache, reuse the tables built from an identical grammar file.
+    // Table conflicts are reported on stderr; --strict makes them fatal.
+    LL1Parser parser;
+    parser.setEbnf(ebnf);
+    parser.setAnalysisThreads(jobs);
+    parser.setErrorLimit(maxErrors);
+    parser.setStrict(strict);
+    if (lalr) cacheFile.clear();    // the cache holds LL(1) tables
+    uint64_t grammarHash = cacheFile.empty() ? 0 : hashFile(args[0]) ^ (ebnf ? 0x9e3779b97f4a7c15ull : 0) ^ (reduce ? 0xc2b2ae3d27d4eb4full : 0)
+        ^ (rewrite ? 0x165667b19e3779f9ull : 0);
+    try {
+        if (cacheFile.empty() || !parser.loadTables(cacheFile, grammarHash)) {
+            parser.loadGrammar(args[0]);
+            if (rewrite) writeRewrite(cerr, parser.rewriteGrammar());
+            if (reduce) writeReduction(cerr, parser.reduceGrammar());
+            parser.computeFirst();
+            if (!lalr) {
+                parser.computeFollow();
+                parser.buildParseTable();
+            }
+            if (!cacheFile.empty()) parser.saveTables(cacheFile, grammarHash);
+        }
+    }
+    catch (const exception& e) {
+        parser.writeConflicts(cerr);
+        cerr << e.what() << endl;
+        return 1;
+    }
+    parser.writeConflicts(cerr);
+    if (lalr) return runLALR(parser, args[1], args[2], strict, printStats);
+    if (generate) return runGenerate(parser, generatorOptions, generateTokens, generateEdits, args[1], args.size() > 2 ? args[2] : "");
+    if (fuzzCases > 0) return runFuzz(parser, generatorOptions, fuzzCases, generateTokens);
+    if (!emitFile.empty()) return emitParser(parser, emitFile);
+    if (batch) return runBatch(parser, args[1], args[2], jobs);
+
+    // --stats reports every phase as JSON on stderr, keeping stdout YES/NO
+    uint64_t loadTokensNs = 0, parseNs = 0;
+    ParseStats parseStats;
+    ParseTree tree;
+    TokenFile tokens;
+    {
+        PhaseTimer timer(loadTokensNs);
+        tokens.open(args[1], parser.getSymbols());
+    }
+    SyncPoint sync;
+    if (!syncTerminal.empty()) {
+        sync.terminal = parser.getSymbols().find(syncTerminal);
+        istringstream names(syncRestart);
+        for (string name; names >> name;) sync.restart.push_back(parser.getSymbols().find(name));
+        if (!isTerminalId(sync.terminal) || sync.terminal == NO_SYMBOL || sync.restart.empty()
+            || find(sync.restart.begin(), sync.restart.end(), NO_SYMBOL) != sync.restart.end()) {
+            cerr << "--sync needs a terminal and restart symbols of the grammar" << endl;
+            return 1;
+        }
+    }
+    // --trace writes every parse step, formatted off the parsing thread;
+    // either option dumps the last steps before each error
+    ofstream traceOut;
+    unique_ptr<ParseTracer> tracer;
+    if (!traceFile.empty() || traceErrors) {
+        if (!traceFile.empty()) traceOut.open(traceFile, ios::binary);
+        tracer = make_unique<ParseTracer>(parser, traceFile.empty() ? nullptr : &traceOut, traceLast);
+    }
+    {
+        PhaseTimer timer(parseNs);
+        if (sync.terminal != NO_SYMBOL && treeFile.empty() && !tracer) {
+            LazyFileSink errors(args[2]);
+            bool accepted = parser.parseChunked(tokens.data(), tokens.size(), errors, sync, jobs, &parseStats);
+            cout << (accepted ? "YES\n" : "NO\n");
+        }
+        else parser.parseTokens(tokens, args[2], &parseStats, treeFile.empty() ? nullptr : &tree, tracer.get());
+    }
+    if (!treeFile.empty()) {
+        ofstream treeOut(treeFile);
+        writeParseTree(treeOut, tree, parser.getSymbols(), tokens.data());
+    }
+    if (printStats) writeStatsJson(cerr, parser.getStats(), parseStats, tokens.size(), loadTokensNs, parseNs);
+    return 0;
+}
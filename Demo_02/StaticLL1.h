@@ -0,0 +1,366 @@
+﻿#pragma once
+// LL(1) parser for a grammar fixed when the program is built. The compiler
+// reads the grammar text, interns its symbols and computes FIRST, FOLLOW
+// and the parse table, so nothing is built at start-up and the parse loop
+// works on static constexpr arrays. Grammar text follows the same rules as
+// LL1Parser::loadGrammar without EBNF, and parse() accepts and rejects the
+// same token sequences with the same error messages.
+//
+//   constexpr char exprGrammar[] = "E -> T E'\n" ... ;
+//   bool accepted = StaticLL1Parser<exprGrammar>::parse(tokens, count, errors);
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// Splitting grammar text into lines and words at compile time
+struct StaticGrammarText {
+    static constexpr bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+
+    static constexpr std::string_view withoutBom(std::string_view text) {
+        return text.substr(0, 3) == "\xEF\xBB\xBF" ? text.substr(3) : text;
+    }
+
+    static constexpr size_t lineEnd(std::string_view text, size_t p) {
+        size_t end = text.find('\n', p);
+        return end == std::string_view::npos ? text.size() : end;
+    }
+
+    // Next word before end, advancing p; empty when the line has no more
+    static constexpr std::string_view nextWord(std::string_view text, size_t& p, size_t end) {
+        while (p < end && isSpace(text[p])) ++p;
+        size_t start = p;
+        while (p < end && !isSpace(text[p])) ++p;
+        return text.substr(start, p - start);
+    }
+
+    static constexpr bool isQuoted(std::string_view word) {
+        return word.size() >= 3 && word.front() == '\'' && word.back() == '\'';
+    }
+
+    // FNV-1a, for the symbol name hash table
+    static constexpr uint32_t hash(std::string_view name) {
+        uint32_t h = 2166136261u;
+        for (char c : name) h = (h ^ (unsigned char)c) * 16777619u;
+        return h;
+    }
+
+    // Array sizes for StaticGrammar: every word, and one alternative per
+    // line plus one per '|' (at least 1 so no array is empty)
+    static constexpr size_t wordCount(std::string_view text) {
+        size_t count = 1;
+        for (size_t p = 0; p < text.size();) {
+            size_t end = lineEnd(text, p);
+            while (!nextWord(text, p, end).empty()) ++count;
+            p = end + 1;
+        }
+        return count;
+    }
+
+    static constexpr size_t alternativeCount(std::string_view text) {
+        size_t count = 1;
+        for (size_t p = 0; p < text.size();) {
+            size_t end = lineEnd(text, p);
+            ++count;
+            for (std::string_view word = nextWord(text, p, end); !word.empty(); word = nextWord(text, p, end)) {
+                if (word == "|") ++count;
+            }
+            p = end + 1;
+        }
+        return count;
+    }
+};
+
+// Symbol names by ID, with the numbering of SymbolTable: terminals from 0
+// ("$"), nonterminals ~0, ~1, ...
+template <size_t MaxSymbols>
+struct StaticSymbolTable {
+    std::array<std::string_view, MaxSymbols> terminals{}, nonTerminals{};
+    int terminalCount = 1, nonTerminalCount = 0;
+
+    constexpr StaticSymbolTable() { terminals[0] = "$"; }
+
+    // INT_MAX (NO_SYMBOL) for unknown names and for "$", as SymbolTable::find
+    constexpr int find(std::string_view name) const {
+        for (int t = 1; t < terminalCount; ++t) {
+            if (terminals[t] == name) return t;
+        }
+        for (int n = 0; n < nonTerminalCount; ++n) {
+            if (nonTerminals[n] == name) return ~n;
+        }
+        return INT_MAX;
+    }
+    constexpr int addTerminal(std::string_view name) {
+        int id = find(name);
+        if (id != INT_MAX) return id;
+        terminals[terminalCount] = name;
+        return terminalCount++;
+    }
+    constexpr int addNonTerminal(std::string_view name) {
+        int id = find(name);
+        if (id != INT_MAX) return id;
+        nonTerminals[nonTerminalCount] = name;
+        return ~nonTerminalCount++;
+    }
+};
+
+// Productions of a grammar text with interned symbols, as GrammarReader
+// and LL1Parser::loadGrammar produce them
+template <size_t Words, size_t Alternatives>
+struct StaticGrammar {
+    StaticSymbolTable<Words + Alternatives> symbols;
+    std::array<int, Alternatives> lhs{};
+    std::array<int, Words> rhs{};
+    std::array<size_t, Alternatives + 1> rhsStart{};    // production p is rhs[rhsStart[p]..rhsStart[p + 1])
+    size_t productionCount = 0;
+    int startSymbol = INT_MAX;
+
+    constexpr explicit StaticGrammar(std::string_view text) {
+        typedef StaticGrammarText Text;
+        text = Text::withoutBom(text);
+
+        // Split into productions whose symbols are still names
+        std::array<std::string_view, Alternatives> lhsNames{};
+        std::array<std::string_view, Words> words{};
+        std::array<bool, Words> quoted{};
+        std::array<size_t, Alternatives + 1> wordStart{};
+        size_t wordCount = 0;
+        std::string_view currentLhs, start;
+        for (size_t p = 0; p < text.size();) {
+            size_t end = Text::lineEnd(text, p);
+            size_t pos = p;
+            std::string_view first = Text::nextWord(text, pos, end);
+            size_t afterFirst = pos;
+            std::string_view second = Text::nextWord(text, pos, end);
+            size_t afterArrow = pos;
+            std::string_view third = Text::nextWord(text, pos, end);
+            if (second == "->" && !third.empty()) {
+                currentLhs = Text::isQuoted(first) ? first.substr(1, first.size() - 2) : first;
+                pos = afterArrow;
+            }
+            else if (first == "|" && !second.empty() && !currentLhs.empty()) {
+                pos = afterFirst;
+            }
+            else {
+                p = end + 1;
+                continue;
+            }
+            lhsNames[productionCount] = currentLhs;
+            wordStart[productionCount] = wordCount;
+            for (std::string_view word = Text::nextWord(text, pos, end); !word.empty(); word = Text::nextWord(text, pos, end)) {
+                if (word == "|") {
+                    lhsNames[++productionCount] = currentLhs;
+                    wordStart[productionCount] = wordCount;
+                    continue;
+                }
+                quoted[wordCount] = Text::isQuoted(word);
+                words[wordCount] = quoted[wordCount] ? word.substr(1, word.size() - 2) : word;
+                ++wordCount;
+            }
+            wordStart[++productionCount] = wordCount;
+            if (start.empty()) start = currentLhs;
+            p = end + 1;
+        }
+
+        // Intern: LHS names and capitalised names are nonterminals,
+        // "epsilon" only marks an empty RHS
+        size_t rhsCount = 0;
+        for (size_t p = 0; p < productionCount; ++p) {
+            lhs[p] = symbols.addNonTerminal(lhsNames[p]);
+            rhsStart[p] = rhsCount;
+            for (size_t w = wordStart[p]; w < wordStart[p + 1]; ++w) {
+                std::string_view word = words[w];
+                if (quoted[w]) {
+                    rhs[rhsCount++] = symbols.addTerminal(word);
+                    continue;
+                }
+                if (word == "epsilon") continue;
+                bool isLhs = false;
+                for (size_t q = 0; q < productionCount && !isLhs; ++q) isLhs = lhsNames[q] == word;
+                rhs[rhsCount++] = (word[0] >= 'A' && word[0] <= 'Z') || isLhs ? symbols.addNonTerminal(word) : symbols.addTerminal(word);
+            }
+        }
+        rhsStart[productionCount] = rhsCount;
+        if (!start.empty()) startSymbol = symbols.find(start);
+    }
+};
+
+template <const char* Grammar>
+class StaticLL1Parser {
+    typedef StaticGrammarText Text;
+    static constexpr size_t WORDS = Text::wordCount(Grammar);
+    static constexpr size_t ALTERNATIVES = Text::alternativeCount(Grammar);
+    static constexpr StaticGrammar<WORDS, ALTERNATIVES> grammar{ std::string_view(Grammar) };
+    static constexpr int T = grammar.symbols.terminalCount;
+    static constexpr int N = grammar.symbols.nonTerminalCount;
+    static constexpr size_t SYMBOLS = (size_t)T - 1 + N;     // every name but "$"
+    static constexpr uint16_t NONE = 0xFFFF;
+    static constexpr size_t slotCount() {
+        size_t slots = 4;
+        while (slots < 2 * SYMBOLS) slots *= 2;
+        return slots;
+    }
+    static constexpr size_t SLOTS = slotCount();     // power of two, at most half full
+
+    struct Tables {
+        std::array<uint16_t, (size_t)N * T> table{};       // [nonterminal][terminal], NONE if empty
+        std::array<int, WORDS> pushSymbols{};               // every RHS reversed, in push order
+        std::array<size_t, ALTERNATIVES + 1> pushStart{};
+        std::array<std::string_view, SLOTS> slotNames{};   // open addressing by hash for find()
+        std::array<int, SLOTS> slotIds{};
+    };
+
+    // FIRST(rhs[from..end)) into out (T + 1 flags, the last one epsilon)
+    template <class Sets>
+    static constexpr void addFirstOf(const Sets& first, size_t from, size_t end, std::array<bool, T + 1>& out) {
+        for (size_t i = from; i < end; ++i) {
+            int symbol = grammar.rhs[i];
+            if (symbol >= 0) {
+                out[symbol] = true;
+                return;
+            }
+            for (int t = 0; t < T; ++t) out[t] = out[t] || first[~symbol][t];
+            if (!first[~symbol][T]) return;
+        }
+        out[T] = true;
+    }
+
+    static constexpr void insertName(Tables& tables, std::string_view name, int id) {
+        size_t slot = Text::hash(name) & (SLOTS - 1);
+        while (tables.slotIds[slot] != INT_MAX) slot = (slot + 1) & (SLOTS - 1);
+        tables.slotNames[slot] = name;
+        tables.slotIds[slot] = id;
+    }
+
+    static constexpr Tables buildTables() {
+        Tables result{};
+        std::array<std::array<bool, T + 1>, N> first{};
+        std::array<std::array<bool, T + 1>, N> follow{};
+        size_t productions = grammar.productionCount;
+
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (size_t p = 0; p < productions; ++p) {
+                std::array<bool, T + 1> sequence{};
+                addFirstOf(first, grammar.rhsStart[p], grammar.rhsStart[p + 1], sequence);
+                for (int t = 0; t <= T; ++t) {
+                    if (sequence[t] && !first[~grammar.lhs[p]][t]) changed = first[~grammar.lhs[p]][t] = true;
+                }
+            }
+        }
+
+        if (grammar.startSymbol != INT_MAX) follow[~grammar.startSymbol][0] = true;
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (size_t p = 0; p < productions; ++p) {
+                for (size_t i = grammar.rhsStart[p]; i < grammar.rhsStart[p + 1]; ++i) {
+                    int symbol = grammar.rhs[i];
+                    if (symbol >= 0) continue;
+                    std::array<bool, T + 1> trailer{};
+                    addFirstOf(first, i + 1, grammar.rhsStart[p + 1], trailer);
+                    for (int t = 0; t < T; ++t) {
+                        bool add = trailer[t] || (trailer[T] && follow[~grammar.lhs[p]][t]);
+                        if (add && !follow[~symbol][t]) changed = follow[~symbol][t] = true;
+                    }
+                }
+            }
+        }
+
+        // Later productions overwrite earlier ones, as in buildParseTable
+        for (uint16_t& cell : result.table) cell = NONE;
+        for (size_t p = 0; p < productions; ++p) {
+            std::array<bool, T + 1> sequence{};
+            addFirstOf(first, grammar.rhsStart[p], grammar.rhsStart[p + 1], sequence);
+            int row = ~grammar.lhs[p];
+            for (int t = 0; t < T; ++t) {
+                if (sequence[t] || (sequence[T] && follow[row][t])) result.table[(size_t)row * T + t] = (uint16_t)p;
+            }
+            result.pushStart[p] = grammar.rhsStart[p];
+            for (size_t i = grammar.rhsStart[p + 1]; i-- > grammar.rhsStart[p];) {
+                result.pushSymbols[grammar.rhsStart[p] + grammar.rhsStart[p + 1] - 1 - i] = grammar.rhs[i];
+            }
+        }
+        result.pushStart[productions] = grammar.rhsStart[productions];
+
+        for (int& id : result.slotIds) id = INT_MAX;
+        for (int t = 1; t < T; ++t) insertName(result, grammar.symbols.terminals[t], t);
+        for (int n = 0; n < N; ++n) insertName(result, grammar.symbols.nonTerminals[n], ~n);
+        return result;
+    }
+
+    static constexpr Tables tables = buildTables();
+
+    static uint16_t lookup(int nonTerminal, int terminal) {
+        if ((unsigned)terminal >= (unsigned)T) return NONE;
+        return tables.table[(size_t)~nonTerminal * T + terminal];
+    }
+
+public:
+    static constexpr int terminalCount = T;
+    static constexpr int nonTerminalCount = N;
+    static constexpr size_t productionCount = grammar.productionCount;
+
+    // ID of a symbol name, INT_MAX if the grammar does not use it
+    static int find(std::string_view name) {
+        for (size_t slot = Text::hash(name) & (SLOTS - 1);; slot = (slot + 1) & (SLOTS - 1)) {
+            int id = tables.slotIds[slot];
+            if (id == INT_MAX || tables.slotNames[slot] == name) return id;
+        }
+    }
+
+    static constexpr std::string_view name(int id) {
+        return id >= 0 ? grammar.symbols.terminals[id] : grammar.symbols.nonTerminals[~id];
+    }
+
+    // Parse tokens with line, type and value members (type and value
+    // convertible to string_view) and write the first syntax error, if
+    // any, to errors. True if the whole sequence is accepted.
+    template <class TokenT>
+    static bool parse(const TokenT* tokens, size_t count, std::ostream& errors) {
+        std::vector<int> stack;
+        stack.reserve(1024);
+        stack.push_back(0);
+        if (grammar.startSymbol != INT_MAX) stack.push_back(grammar.startSymbol);
+        for (size_t i = 0; i < count; ++i) {
+            int type = find(std::string_view(tokens[i].type));
+            while (true) {
+                int top = stack.back();
+                if (top == type) {
+                    stack.pop_back();
+                    break;
+                }
+                uint16_t production = top >= 0 ? NONE : lookup(top, type);
+                if (production == NONE) {
+                    errors << "Syntax error at line " << tokens[i].line << ": ";
+                    if (top > 0) errors << "expected '" << name(top) << "' but found '" << std::string_view(tokens[i].value) << "'\n";
+                    else errors << "unexpected token '" << std::string_view(tokens[i].value) << "'\n";
+                    return false;
+                }
+                expand(stack, production);
+            }
+        }
+        while (true) {
+            int top = stack.back();
+            if (top == 0) return true;
+            uint16_t production = top > 0 ? NONE : lookup(top, 0);
+            if (production != NONE) {
+                expand(stack, production);
+                continue;
+            }
+            if (top > 0) errors << "Syntax error at line -1: expected '" << name(top) << "' but found '$'\n";
+            else if (count == 0) errors << "Syntax error at line -1: unexpected token '$'\n";
+            else errors << "Syntax error at line " << tokens[count - 1].line << ": unexpected token '" << std::string_view(tokens[count - 1].value) << "'\n";
+            return false;
+        }
+    }
+
+private:
+    static void expand(std::vector<int>& stack, uint16_t production) {
+        stack.pop_back();
+        stack.insert(stack.end(), tables.pushSymbols.begin() + tables.pushStart[production], tables.pushSymbols.begin() + tables.pushStart[production + 1]);
+    }
+};